@@ -0,0 +1,496 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "BigInt.h"
+#include "Driver.h"
+#include "Metadata.h"
+
+
+/*
+    Benchmarks the tools on reproducible semiprimes.  For each width of N,
+    each shape (balanced: two factors of half the width; unbalanced: one of
+    a quarter) and each of --count instances, two random primes are drawn
+    from a generator seeded by (--seed, width, shape, instance), so any one
+    instance comes out the same whatever else is run.  Every encoding
+    variant of each N is written by iencode and timed, with its size and
+    peak RSS; a --solver, when given, is timed on it under --timeout, and
+    extract-sat is timed on the solver's model (or, without a solver, on a
+    model made from the known factors) and must reproduce N.
+
+    One row per instance, variant and solver goes to standard output as
+    CSV, or to the --csv and --json files.  --label tags every row, so runs
+    of different commits or options can be put side by side.
+*/
+
+
+namespace { // unnamed
+  const char* Shapes[] = { "balanced", "unbalanced" };
+} // unnamed
+
+struct Options {
+  Options() : count_(3), seed_(1), timeout_(60), keep_(false), workDir_("/tmp")
+  { /* */ }
+
+  std::vector<long> bits_;
+  std::vector<std::string> shapes_, variants_, solvers_;
+  long count_, seed_, timeout_;
+  bool keep_;
+  std::string binDir_, workDir_, csv_, json_, label_;
+};
+
+// One encoding of one N, and what each tool made of it; -1 where a value
+//  was not measured
+struct Row {
+  Row() : bits_(0), instance_(0), vars_(-1), clauses_(-1), bytes_(-1),
+          encodeSeconds_(-1), encodeKB_(-1), solveSeconds_(-1), extractSeconds_(-1)
+  { /* */ }
+
+  long bits_, instance_;
+  std::string shape_, n_, p_, q_, variant_, solver_, result_, verified_;
+  long vars_, clauses_, bytes_;
+  double encodeSeconds_;
+  long encodeKB_;
+  double solveSeconds_, extractSeconds_;
+};
+
+std::string Usage() {
+  std::string rtn = "bench [options]";
+  rtn += "\nExample: bench --bits 16,24,32 --solver kissat --timeout 60 --csv results.csv";
+  rtn += "\n\nOptions:";
+  rtn += "\n  --bits B,B,...  widths of N (default 16,20,24,28,32; at least 4)";
+  rtn += "\n  --count K       semiprimes per width and shape (default 3)";
+  rtn += "\n  --seed S        seed of the generator (default 1)";
+  rtn += "\n  --shapes LIST   balanced, unbalanced or both (the default):";
+  rtn += "\n                  factors of n/2 bits, or of n/4 and 3n/4 bits";
+  rtn += "\n  --variant OPTS  iencode options of one encoding variant, repeatable";
+  rtn += "\n                  (default: iencode's defaults)";
+  rtn += "\n  --solver CMD    a solver command line, repeatable, as for portfolio:";
+  rtn += "\n                  {cnf} is the CNF (appended when absent), {out} a";
+  rtn += "\n                  result file the solver writes, else its standard output";
+  rtn += "\n  --timeout S     per solver run (default 60)";
+  rtn += "\n  --csv FILE      write the results as CSV (default: standard output)";
+  rtn += "\n  --json FILE     write the results as JSON";
+  rtn += "\n  --label L       tag every row, e.g. with a commit";
+  rtn += "\n  --bin DIR       where iencode and extract-sat are (default: next to";
+  rtn += "\n                  bench)";
+  rtn += "\n  --workdir DIR   where CNF and result files go (default /tmp)";
+  rtn += "\n  --keep          leave those files behind";
+  return(rtn);
+}
+
+std::vector<std::string> SplitList(const std::string& s, char delim) {
+  std::vector<std::string> pieces;
+  std::stringstream in(s);
+  std::string piece;
+  while ( std::getline(in, piece, delim) ) {
+    if ( !piece.empty() )
+      pieces.push_back(piece);
+  } // while
+  return(pieces);
+}
+
+Options ParseArgs(int argc, char* argv[]) {
+  Options opts;
+  opts.binDir_ = Driver::BinDir(argv[0]);
+  for ( int i = 1; i < argc; ++i ) {
+    std::string arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if ( arg == "--bits" && hasValue ) {
+      std::vector<std::string> widths = SplitList(argv[++i], ',');
+      for ( std::size_t w = 0; w < widths.size(); ++w ) {
+        opts.bits_.push_back(Driver::Number(widths[w], arg));
+        if ( opts.bits_.back() < 4 )
+          throw(std::string("Bad value for --bits: at least 4"));
+      } // for
+    }
+    else if ( arg == "--count" && hasValue )
+      opts.count_ = Driver::Number(argv[++i], arg);
+    else if ( arg == "--seed" && hasValue )
+      opts.seed_ = Driver::Number(argv[++i], arg);
+    else if ( arg == "--shapes" && hasValue ) {
+      opts.shapes_ = SplitList(argv[++i], ',');
+      for ( std::size_t s = 0; s < opts.shapes_.size(); ++s ) {
+        if ( opts.shapes_[s] != Shapes[0] && opts.shapes_[s] != Shapes[1] )
+          throw(std::string("Bad value for --shapes: ") + opts.shapes_[s]);
+      } // for
+    }
+    else if ( arg == "--variant" && hasValue )
+      opts.variants_.push_back(argv[++i]);
+    else if ( arg == "--solver" && hasValue )
+      opts.solvers_.push_back(argv[++i]);
+    else if ( arg == "--timeout" && hasValue )
+      opts.timeout_ = Driver::Number(argv[++i], arg);
+    else if ( arg == "--csv" && hasValue )
+      opts.csv_ = argv[++i];
+    else if ( arg == "--json" && hasValue )
+      opts.json_ = argv[++i];
+    else if ( arg == "--label" && hasValue )
+      opts.label_ = argv[++i];
+    else if ( arg == "--bin" && hasValue )
+      opts.binDir_ = argv[++i];
+    else if ( arg == "--workdir" && hasValue )
+      opts.workDir_ = argv[++i];
+    else if ( arg == "--keep" )
+      opts.keep_ = true;
+    else
+      throw(std::string("Unexpected argument: ") + arg);
+  } // for
+
+  if ( opts.bits_.empty() ) {
+    const long widths[] = { 16, 20, 24, 28, 32 };
+    opts.bits_.assign(widths, widths + 5);
+  }
+  if ( opts.shapes_.empty() )
+    opts.shapes_.assign(Shapes, Shapes + 2);
+  if ( opts.variants_.empty() )
+    opts.variants_.push_back("");
+  return(opts);
+}
+
+// xorshift32, seeded from every value given: one generator per instance
+struct Random {
+  explicit Random(const std::vector<long>& seeds) : state_(2166136261UL) {
+    for ( std::size_t i = 0; i < seeds.size(); ++i ) {
+      state_ ^= static_cast<unsigned long>(seeds[i]) & Mask;
+      state_ = (state_ * 16777619UL) & Mask;
+    } // for
+    if ( 0 == state_ )
+      state_ = 1;
+  }
+
+  unsigned long Next() {
+    state_ ^= (state_ << 13) & Mask;
+    state_ ^= state_ >> 17;
+    state_ ^= (state_ << 5) & Mask;
+    return(state_);
+  }
+
+  // A prime of exactly 'bits' bits (at least 2)
+  BigInt Prime(long bits) {
+    for ( ;; ) {
+      std::string digits(bits, '1');
+      for ( long i = 1; i + 1 < bits; ++i )
+        digits[i] = ((Next() >> 7) & 1) ? '1' : '0';
+      BigInt candidate = BigInt::FromBinary(digits);
+      if ( candidate.IsProbablePrime() )
+        return(candidate);
+    } // for
+  }
+
+private:
+  static const unsigned long Mask = 0xFFFFFFFFUL;
+  unsigned long state_;
+};
+
+// Runs a solver for at most 'timeout' seconds.  Returns its wait status, or
+//  -1 when it was stopped.
+int RunSolver(const std::string& command, const std::string& outFile, long timeout) {
+  pid_t pid = Driver::Launch(command, outFile, -1);
+  Driver::Alarm(timeout);
+  int status = Driver::Wait(pid);
+  Driver::Alarm(0);
+  if ( -1 == status )
+    Driver::Stop(pid);
+  return(status);
+}
+
+// SAT, UNSAT or UNKNOWN, from the exit code (10/20) or the output
+std::string Verdict(int status, const std::string& outFile) {
+  if ( Driver::Exited(status, 10) )
+    return("SAT");
+  else if ( Driver::Exited(status, 20) )
+    return("UNSAT");
+  std::ifstream in(outFile.c_str());
+  std::string line;
+  while ( std::getline(in, line) ) {
+    std::stringstream words(line);
+    std::string word;
+    words >> word;
+    if ( word == "s" )
+      words >> word;
+    if ( word == "SATISFIABLE" || word == "SAT" )
+      return("SAT");
+    else if ( word == "UNSATISFIABLE" || word == "UNSAT" )
+      return("UNSAT");
+  } // while
+  return("UNKNOWN");
+}
+
+// The 'p' line's counts and the factor bits' variables, from the CNF's
+//  header; false when it has none (a compressed file, say)
+bool ReadHeader(const std::string& cnf, Row& row, Metadata& meta) {
+  std::ifstream in(cnf.c_str());
+  std::string line;
+  while ( std::getline(in, line) && !line.empty() && line[0] == 'c' )
+    meta.Read(line);
+  std::stringstream words(line);
+  std::string p, format;
+  if ( !(words >> p >> format >> row.vars_ >> row.clauses_) || p != "p" ) {
+    row.vars_ = row.clauses_ = -1;
+    return(false);
+  }
+  return(meta.Complete());
+}
+
+// A model setting the factor bits to 'a' (the narrower factor) and 'b', for
+//  timing extract-sat without a solver; false when they do not fit
+bool WriteModel(const Metadata& meta, BigInt a, BigInt b, const std::string& name) {
+  if ( meta.widthA_ > meta.widthB_ )
+    std::swap(a, b);
+  if ( a.Bits() > static_cast<std::size_t>(meta.widthA_)
+       || b.Bits() > static_cast<std::size_t>(meta.widthB_) )
+    return(false);
+  std::ofstream out(name.c_str());
+  out << "s SATISFIABLE" << std::endl << "v";
+  for ( long i = 0; i < meta.widthA_; ++i ) {
+    if ( meta.varsA_[i] )
+      out << " " << (a.Bit(i) ? meta.varsA_[i] : -meta.varsA_[i]);
+  } // for
+  for ( long i = 0; i < meta.widthB_; ++i ) {
+    if ( meta.varsB_[i] )
+      out << " " << (b.Bit(i) ? meta.varsB_[i] : -meta.varsB_[i]);
+  } // for
+  out << " 0" << std::endl;
+  return(!out.fail());
+}
+
+// Times extract-sat on 'cnf' and 'model': "yes" when it printed factors of
+//  N, which it checks itself against the 'c N =' comment
+std::string Extract(const Options& opts, const std::string& cnf, const std::string& model,
+                    const std::string& outFile, double& seconds) {
+  std::vector<std::string> args;
+  args.push_back("--base=10");
+  args.push_back(cnf);
+  args.push_back(model);
+  double start = Driver::Seconds();
+  int status = Driver::Run(opts.binDir_ + "/extract-sat", args, outFile);
+  seconds = Driver::Seconds() - start;
+  std::ifstream in(outFile.c_str());
+  std::string line;
+  std::getline(in, line);
+  bool ok = Driver::Exited(status, 0) && line.compare(0, 14, "First Factor: ") == 0;
+  return(ok ? "yes" : "no");
+}
+
+std::string Quoted(const std::string& s, bool json) {
+  std::string rtn = "\"";
+  for ( std::size_t i = 0; i < s.size(); ++i ) {
+    if ( s[i] == '"' )
+      rtn += json ? "\\\"" : "\"\"";
+    else if ( s[i] == '\\' && json )
+      rtn += "\\\\";
+    else
+      rtn += s[i];
+  } // for
+  return(rtn + "\"");
+}
+
+// A measurement, or nothing (CSV) / null (JSON) when not taken
+template <typename T>
+std::string Value(T value, bool json) {
+  if ( value < 0 )
+    return(json ? "null" : "");
+  std::stringstream out;
+  out << std::fixed << std::setprecision(6) << value;
+  std::string rtn = out.str();
+  if ( rtn.find('.') != std::string::npos ) { // drop trailing zeros
+    rtn.erase(rtn.find_last_not_of('0') + 1);
+    if ( rtn[rtn.size() - 1] == '.' )
+      rtn.erase(rtn.size() - 1);
+  }
+  return(rtn);
+}
+
+void WriteCsv(std::ostream& out, const std::string& label, const std::vector<Row>& rows) {
+  out << "label,bits,shape,instance,n,p,q,variant,variables,clauses,cnf_bytes,"
+      << "encode_s,encode_rss_kb,solver,result,solve_s,extract_s,verified" << std::endl;
+  for ( std::size_t i = 0; i < rows.size(); ++i ) {
+    const Row& r = rows[i];
+    out << Quoted(label, false) << "," << r.bits_ << "," << r.shape_ << "," << r.instance_
+        << "," << r.n_ << "," << r.p_ << "," << r.q_ << "," << Quoted(r.variant_, false)
+        << "," << Value(r.vars_, false) << "," << Value(r.clauses_, false)
+        << "," << Value(r.bytes_, false) << "," << Value(r.encodeSeconds_, false)
+        << "," << Value(r.encodeKB_, false) << "," << Quoted(r.solver_, false)
+        << "," << r.result_ << "," << Value(r.solveSeconds_, false)
+        << "," << Value(r.extractSeconds_, false) << "," << r.verified_ << std::endl;
+  } // for
+}
+
+void WriteJson(std::ostream& out, const std::string& label, const std::vector<Row>& rows) {
+  out << "[";
+  for ( std::size_t i = 0; i < rows.size(); ++i ) {
+    const Row& r = rows[i];
+    out << (i ? ",\n " : "\n ") << "{\"label\": " << Quoted(label, true)
+        << ", \"bits\": " << r.bits_ << ", \"shape\": \"" << r.shape_ << "\""
+        << ", \"instance\": " << r.instance_ << ", \"n\": \"" << r.n_ << "\""
+        << ", \"p\": \"" << r.p_ << "\", \"q\": \"" << r.q_ << "\""
+        << ", \"variant\": " << Quoted(r.variant_, true)
+        << ", \"variables\": " << Value(r.vars_, true) << ", \"clauses\": " << Value(r.clauses_, true)
+        << ", \"cnf_bytes\": " << Value(r.bytes_, true)
+        << ", \"encode_s\": " << Value(r.encodeSeconds_, true)
+        << ", \"encode_rss_kb\": " << Value(r.encodeKB_, true)
+        << ", \"solver\": " << Quoted(r.solver_, true) << ", \"result\": \"" << r.result_ << "\""
+        << ", \"solve_s\": " << Value(r.solveSeconds_, true)
+        << ", \"extract_s\": " << Value(r.extractSeconds_, true)
+        << ", \"verified\": \"" << r.verified_ << "\"}";
+  } // for
+  out << "\n]" << std::endl;
+}
+
+
+//========
+// main()
+//========
+int main(int argc, char* argv[]) {
+  std::vector<std::string> files;
+  bool keep = true;
+  int rtn = EXIT_FAILURE;
+  try {
+    if ( argc == 2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help") ) {
+      std::cout << Usage() << std::endl;
+      return(EXIT_SUCCESS);
+    }
+    Options opts = ParseArgs(argc, argv);
+    keep = opts.keep_;
+    Driver::CatchAlarm();
+
+    std::stringstream base;
+    base << opts.workDir_ << "/bench-" << getpid();
+
+    std::vector<Row> rows;
+    for ( std::size_t w = 0; w < opts.bits_.size(); ++w ) {
+      for ( std::size_t s = 0; s < opts.shapes_.size(); ++s ) {
+        bool balanced = (opts.shapes_[s] == Shapes[0]);
+        for ( long k = 0; k < opts.count_; ++k ) {
+          // A semiprime of exactly 'bits' bits
+          long bits = opts.bits_[w];
+          long small = balanced ? bits / 2 : std::max(2L, bits / 4);
+          std::vector<long> seeds;
+          seeds.push_back(opts.seed_);
+          seeds.push_back(bits);
+          seeds.push_back(balanced ? 0 : 1);
+          seeds.push_back(k);
+          Random random(seeds);
+          BigInt p, q, n;
+          do {
+            p = random.Prime(small);
+            q = random.Prime(bits - small);
+            n = p * q;
+          } while ( n.Bits() != static_cast<std::size_t>(bits) );
+
+          for ( std::size_t v = 0; v < opts.variants_.size(); ++v ) {
+            std::stringstream name;
+            name << base.str() << "-" << bits << "-" << opts.shapes_[s] << "-" << k << "-v" << v;
+            std::string cnf = name.str() + ".cnf";
+            files.push_back(cnf);
+            Row row;
+            row.bits_ = bits;
+            row.shape_ = opts.shapes_[s];
+            row.instance_ = k;
+            row.n_ = n.ToDecimal();
+            row.p_ = p.ToDecimal();
+            row.q_ = q.ToDecimal();
+            row.variant_ = opts.variants_[v];
+
+            std::vector<std::string> args = Driver::SplitWords(opts.variants_[v]);
+            args.push_back(n.ToBinary());
+            double start = Driver::Seconds();
+            int status = Driver::Run(opts.binDir_ + "/iencode", args, cnf, &row.encodeKB_);
+            row.encodeSeconds_ = Driver::Seconds() - start;
+            if ( !Driver::Exited(status, 0) )
+              throw(std::string("iencode failed on variant '") + opts.variants_[v] + "'");
+            struct stat st;
+            if ( 0 == stat(cnf.c_str(), &st) )
+              row.bytes_ = static_cast<long>(st.st_size);
+            Metadata meta;
+            bool header = ReadHeader(cnf, row, meta);
+
+            std::vector<std::string> solvers(opts.solvers_);
+            if ( solvers.empty() )
+              solvers.push_back("");
+            for ( std::size_t j = 0; j < solvers.size(); ++j ) {
+              std::stringstream job;
+              job << name.str() << "-s" << j;
+              std::string model = job.str() + ".model", solverOut = job.str() + ".out";
+              std::string extractOut = job.str() + ".extract";
+              files.push_back(model);
+              files.push_back(solverOut);
+              files.push_back(extractOut);
+              Row run(row);
+              run.solver_ = solvers[j];
+              if ( solvers[j].empty() ) { // extract-sat on the known answer
+                run.result_ = "-";
+                if ( header && WriteModel(meta, p, q, model) )
+                  run.verified_ = Extract(opts, cnf, model, extractOut, run.extractSeconds_);
+              } else {
+                std::string command = solvers[j], result = solverOut;
+                if ( command.find("{cnf}") == std::string::npos )
+                  command += " {cnf}";
+                if ( command.find("{out}") != std::string::npos )
+                  result = model;
+                Driver::Replace(command, "{cnf}", "'" + cnf + "'");
+                Driver::Replace(command, "{out}", "'" + model + "'");
+                start = Driver::Seconds();
+                status = RunSolver(command, solverOut, opts.timeout_);
+                run.solveSeconds_ = Driver::Seconds() - start;
+                run.result_ = (-1 == status) ? "TIMEOUT" : Verdict(status, result);
+                if ( run.result_ == "SAT" )
+                  run.verified_ = Extract(opts, cnf, result, extractOut, run.extractSeconds_);
+                else
+                  run.verified_ = "no"; // every N here is composite
+              }
+              std::cerr << bits << " bits " << run.shape_ << " #" << k << " N = " << run.n_
+                        << (run.variant_.empty() ? "" : " [" + run.variant_ + "]")
+                        << (run.solver_.empty() ? "" : " " + run.solver_ + ": " + run.result_)
+                        << std::endl;
+              rows.push_back(run);
+            } // for
+          } // for
+        } // for
+      } // for
+    } // for
+
+    if ( !opts.csv_.empty() ) {
+      std::ofstream out(opts.csv_.c_str());
+      WriteCsv(out, opts.label_, rows);
+      if ( !out )
+        throw(std::string("Unable to write ") + opts.csv_);
+    }
+    if ( !opts.json_.empty() ) {
+      std::ofstream out(opts.json_.c_str());
+      WriteJson(out, opts.label_, rows);
+      if ( !out )
+        throw(std::string("Unable to write ") + opts.json_);
+    }
+    if ( opts.csv_.empty() && opts.json_.empty() )
+      WriteCsv(std::cout, opts.label_, rows);
+    rtn = EXIT_SUCCESS;
+  } catch(std::string& s) {
+    std::cerr << s << std::endl;
+    std::cerr << "use bench -h for help" << std::endl;
+  } catch(std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  } catch(...) {
+    std::cerr << "Unknown runtime error" << std::endl;
+  }
+
+  if ( !keep ) {
+    for ( std::size_t i = 0; i < files.size(); ++i )
+      std::remove(files[i].c_str());
+  }
+  return(rtn);
+}
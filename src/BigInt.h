@@ -0,0 +1,407 @@
+#ifndef SATFACTOR_BIGINT_H
+#define SATFACTOR_BIGINT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+/*
+  BigInt: unsigned integers of any size, enough for the number theory
+   around the SAT stage (trial division, Miller-Rabin, checking a*b = N)
+   and for reading N in decimal or hexadecimal.
+  Digits are 16 bits, least significant first, each held in an unsigned
+   long: a digit product plus carries always fits in 32 bits, so nothing
+   here needs a 64-bit type.  Products use Karatsuba
+   above a few hundred bits; division is Knuth's Algorithm D.
+  Errors (bad digits, division by zero) throw a std::string, as the tools
+   using this header report them.
+*/
+struct BigInt {
+  typedef unsigned long Digit;
+  enum { DigitBits = 16 };
+
+  BigInt(Digit value = 0) : d_() {
+    for ( ; value; value >>= DigitBits )
+      d_.push_back(value & Mask);
+  }
+
+  // Most significant bit first, as iencode takes N
+  static BigInt FromBinary(const std::string& bits) {
+    if ( bits.empty() || bits.find_first_not_of("01") != std::string::npos )
+      throw(std::string("Non Binary # passed in: ") + bits);
+    BigInt rtn;
+    std::size_t n = bits.size();
+    rtn.d_.assign((n + DigitBits - 1) / DigitBits, 0);
+    for ( std::size_t i = 0; i < n; ++i ) {
+      if ( bits[n - 1 - i] == '1' )
+        rtn.d_[i / DigitBits] |= Digit(1) << (i % DigitBits);
+    } // for
+    rtn.trim();
+    return(rtn);
+  }
+
+  // Decimal digits, most significant first.  Four digits (below 2^16) make
+  //  a chunk; adjacent values are then merged pairwise, level by level, so
+  //  the work is dominated by a few large Karatsuba products rather than
+  //  one multiply-by-ten pass per digit.
+  static BigInt FromDecimal(const std::string& digits) {
+    if ( digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos )
+      throw(std::string("Non Decimal # passed in: ") + digits);
+    std::vector<BigInt> level;
+    for ( std::size_t end = digits.size(); end > 0; ) {
+      std::size_t begin = (end >= 4) ? end - 4 : 0;
+      Digit chunk = 0;
+      for ( std::size_t i = begin; i < end; ++i )
+        chunk = chunk * 10 + (digits[i] - '0');
+      level.push_back(BigInt(chunk));
+      end = begin;
+    } // for
+    BigInt scale(10000);
+    while ( level.size() > 1 ) {
+      std::vector<BigInt> next;
+      for ( std::size_t i = 0; i < level.size(); i += 2 )
+        next.push_back(i + 1 < level.size() ? level[i] + level[i + 1] * scale : level[i]);
+      level.swap(next);
+      if ( level.size() > 1 )
+        scale = scale * scale;
+    } // while
+    return(level[0]);
+  }
+
+  // Hexadecimal digits (either case), most significant first
+  static BigInt FromHex(const std::string& digits) {
+    const std::string hex = "0123456789abcdef";
+    if ( digits.empty() )
+      throw(std::string("Non Hexadecimal # passed in: ") + digits);
+    BigInt rtn;
+    std::size_t n = digits.size();
+    rtn.d_.assign((n + 3) / 4, 0);
+    for ( std::size_t i = 0; i < n; ++i ) {
+      char c = digits[n - 1 - i];
+      std::string::size_type v = hex.find((c >= 'A' && c <= 'F') ? c - 'A' + 'a' : c);
+      if ( v == std::string::npos )
+        throw(std::string("Non Hexadecimal # passed in: ") + digits);
+      rtn.d_[i / 4] |= static_cast<Digit>(v) << (4 * (i % 4));
+    } // for
+    rtn.trim();
+    return(rtn);
+  }
+
+  std::string ToBinary() const {
+    if ( IsZero() )
+      return("0");
+    std::string rtn;
+    for ( std::size_t i = Bits(); i-- > 0; )
+      rtn += Bit(i) ? '1' : '0';
+    return(rtn);
+  }
+
+  std::string ToDecimal() const {
+    if ( IsZero() )
+      return("0");
+    std::string rtn;
+    BigInt x(*this);
+    while ( !x.IsZero() ) {
+      Digit r = x.divSmall(10000);
+      for ( int k = 0; k < 4; ++k, r /= 10 )
+        rtn += static_cast<char>('0' + r % 10);
+    } // while
+    while ( rtn.size() > 1 && rtn[rtn.size() - 1] == '0' )
+      rtn.erase(rtn.size() - 1);
+    std::reverse(rtn.begin(), rtn.end());
+    return(rtn);
+  }
+
+  std::string ToHex() const {
+    if ( IsZero() )
+      return("0");
+    const char* hex = "0123456789abcdef";
+    std::string rtn;
+    for ( std::size_t i = (Bits() + 3) / 4; i-- > 0; )
+      rtn += hex[(d_[i / 4] >> (4 * (i % 4))) & 0xF];
+    return(rtn);
+  }
+
+  bool IsZero() const {
+    return(d_.empty());
+  }
+
+  bool IsOdd() const {
+    return(!d_.empty() && (d_[0] & 1));
+  }
+
+  std::size_t Bits() const {
+    if ( d_.empty() )
+      return(0);
+    std::size_t rtn = (d_.size() - 1) * DigitBits;
+    for ( Digit top = d_.back(); top; top >>= 1 )
+      ++rtn;
+    return(rtn);
+  }
+
+  bool Bit(std::size_t i) const {
+    std::size_t k = i / DigitBits;
+    return(k < d_.size() && ((d_[k] >> (i % DigitBits)) & 1));
+  }
+
+  // Remainder by a small divisor (below 2^16)
+  Digit Mod(Digit divisor) const {
+    Digit r = 0;
+    for ( std::size_t i = d_.size(); i-- > 0; )
+      r = ((r << DigitBits) | d_[i]) % divisor;
+    return(r);
+  }
+
+  friend bool operator<(const BigInt& a, const BigInt& b) {
+    return(compare(a, b) < 0);
+  }
+
+  friend bool operator==(const BigInt& a, const BigInt& b) {
+    return(a.d_ == b.d_);
+  }
+
+  friend bool operator!=(const BigInt& a, const BigInt& b) {
+    return(!(a == b));
+  }
+
+  friend BigInt operator+(const BigInt& a, const BigInt& b) {
+    BigInt rtn;
+    Digit carry = 0;
+    for ( std::size_t i = 0; i < std::max(a.d_.size(), b.d_.size()) || carry; ++i ) {
+      Digit t = carry + (i < a.d_.size() ? a.d_[i] : 0) + (i < b.d_.size() ? b.d_[i] : 0);
+      rtn.d_.push_back(t & Mask);
+      carry = t >> DigitBits;
+    } // for
+    return(rtn);
+  }
+
+  // a - b, for a >= b
+  friend BigInt operator-(const BigInt& a, const BigInt& b) {
+    if ( a < b )
+      throw(std::string("BigInt: negative difference"));
+    BigInt rtn(a);
+    Digit borrow = 0;
+    for ( std::size_t i = 0; i < rtn.d_.size(); ++i ) {
+      Digit sub = borrow + (i < b.d_.size() ? b.d_[i] : 0);
+      borrow = (rtn.d_[i] < sub);
+      rtn.d_[i] = (rtn.d_[i] + (borrow << DigitBits) - sub) & Mask;
+    } // for
+    rtn.trim();
+    return(rtn);
+  }
+
+  // Karatsuba once both operands have KaratsubaDigits digits, so checking
+  //  a*b = N on numbers thousands of digits long stays fast
+  friend BigInt operator*(const BigInt& a, const BigInt& b) {
+    if ( a.d_.size() < KaratsubaDigits || b.d_.size() < KaratsubaDigits )
+      return(schoolbook(a, b));
+    const BigInt& big = (a.d_.size() >= b.d_.size()) ? a : b;
+    const BigInt& small = (&big == &a) ? b : a;
+    std::size_t k = big.d_.size() / 2;
+    BigInt big0 = big.digits(0, k), big1 = big.digits(k, big.d_.size());
+    if ( small.d_.size() <= k ) // unbalanced: no split of the smaller side
+      return((big1 * small).shifted(k) + big0 * small);
+
+    BigInt small0 = small.digits(0, k), small1 = small.digits(k, small.d_.size());
+    BigInt z0 = big0 * small0, z2 = big1 * small1;
+    BigInt z1 = (big0 + big1) * (small0 + small1) - z0 - z2;
+    return(z2.shifted(2 * k) + z1.shifted(k) + z0);
+  }
+
+  friend BigInt operator/(const BigInt& a, const BigInt& b) {
+    BigInt q, r;
+    DivMod(a, b, q, r);
+    return(q);
+  }
+
+  friend BigInt operator%(const BigInt& a, const BigInt& b) {
+    BigInt q, r;
+    DivMod(a, b, q, r);
+    return(r);
+  }
+
+  // Knuth, TAOCP vol. 2, 4.3.1 Algorithm D
+  static void DivMod(const BigInt& u, const BigInt& v, BigInt& q, BigInt& r) {
+    if ( v.IsZero() )
+      throw(std::string("BigInt: division by zero"));
+    if ( u < v ) {
+      q = BigInt();
+      r = u;
+      return;
+    } else if ( 1 == v.d_.size() ) {
+      q = u;
+      r = BigInt(q.divSmall(v.d_[0]));
+      return;
+    }
+
+    std::size_t n = v.d_.size(), m = u.d_.size() - n;
+    int s = 0; // normalize: top digit of v gets its high bit set
+    while ( !((v.d_[n - 1] << s) & (Digit(1) << (DigitBits - 1))) )
+      ++s;
+    std::vector<Digit> vn(n), un(u.d_.size() + 1);
+    for ( std::size_t i = n; i-- > 0; )
+      vn[i] = ((v.d_[i] << s) | (i ? v.d_[i - 1] >> (DigitBits - s) : 0)) & Mask;
+    un[u.d_.size()] = s ? u.d_.back() >> (DigitBits - s) : 0;
+    for ( std::size_t i = u.d_.size(); i-- > 0; )
+      un[i] = ((u.d_[i] << s) | (i ? u.d_[i - 1] >> (DigitBits - s) : 0)) & Mask;
+
+    q.d_.assign(m + 1, 0);
+    for ( std::size_t j = m + 1; j-- > 0; ) {
+      Digit num = (un[j + n] << DigitBits) | un[j + n - 1];
+      Digit qhat = num / vn[n - 1], rhat = num % vn[n - 1];
+      while ( qhat > Mask || qhat * vn[n - 2] > ((rhat << DigitBits) | un[j + n - 2]) ) {
+        --qhat;
+        rhat += vn[n - 1];
+        if ( rhat > Mask )
+          break;
+      } // while
+
+      long borrow = 0, t = 0;
+      for ( std::size_t i = 0; i < n; ++i ) {
+        Digit p = qhat * vn[i];
+        t = static_cast<long>(un[i + j]) - borrow - static_cast<long>(p & Mask);
+        un[i + j] = static_cast<Digit>(t) & Mask;
+        borrow = static_cast<long>(p >> DigitBits) - (t < 0 ? -((-t + Mask) >> DigitBits) : 0);
+      } // for
+      t = static_cast<long>(un[j + n]) - borrow;
+      un[j + n] = static_cast<Digit>(t) & Mask;
+
+      q.d_[j] = qhat;
+      if ( t < 0 ) { // qhat was one too big: add v back
+        --q.d_[j];
+        Digit carry = 0;
+        for ( std::size_t i = 0; i < n; ++i ) {
+          Digit sum = un[i + j] + vn[i] + carry;
+          un[i + j] = sum & Mask;
+          carry = sum >> DigitBits;
+        } // for
+        un[j + n] = (un[j + n] + carry) & Mask;
+      }
+    } // for
+    q.trim();
+
+    r.d_.assign(n, 0);
+    for ( std::size_t i = 0; i < n; ++i )
+      r.d_[i] = ((un[i] >> s) | (un[i + 1] << (DigitBits - s))) & Mask;
+    r.trim();
+  }
+
+  // Miller-Rabin to the twelve prime bases 2..37: exact below
+  //  318665857834031151167461 (about 3.2e23, Sorenson and Webster); above
+  //  that only a strong probable-prime test, with no proven error bound
+  bool IsProbablePrime() const {
+    const Digit bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+    const std::size_t count = sizeof(bases) / sizeof(bases[0]);
+    if ( *this < BigInt(2) )
+      return(false);
+    for ( std::size_t i = 0; i < count; ++i ) {
+      if ( *this == BigInt(bases[i]) )
+        return(true);
+      else if ( 0 == Mod(bases[i]) )
+        return(false);
+    } // for
+
+    BigInt one(1), nm1 = *this - one, d = nm1;
+    long s = 0;
+    while ( !d.IsOdd() ) {
+      d = d / BigInt(2);
+      ++s;
+    } // while
+    for ( std::size_t i = 0; i < count; ++i ) {
+      BigInt x = PowMod(BigInt(bases[i]), d, *this);
+      if ( x == one || x == nm1 )
+        continue;
+      bool witness = true;
+      for ( long r = 1; r < s && witness; ++r ) {
+        x = (x * x) % *this;
+        witness = (x != nm1);
+      } // for
+      if ( witness )
+        return(false);
+    } // for
+    return(true);
+  }
+
+  // base^exp mod m
+  static BigInt PowMod(const BigInt& base, const BigInt& exp, const BigInt& m) {
+    BigInt rtn(1), b = base % m;
+    for ( std::size_t i = exp.Bits(); i-- > 0; ) {
+      rtn = (rtn * rtn) % m;
+      if ( exp.Bit(i) )
+        rtn = (rtn * b) % m;
+    } // for
+    return(rtn % m);
+  }
+
+private:
+  enum { Mask = 0xFFFF, KaratsubaDigits = 32 };
+
+  static BigInt schoolbook(const BigInt& a, const BigInt& b) {
+    BigInt rtn;
+    if ( a.IsZero() || b.IsZero() )
+      return(rtn);
+    rtn.d_.assign(a.d_.size() + b.d_.size(), 0);
+    for ( std::size_t i = 0; i < a.d_.size(); ++i ) {
+      Digit carry = 0;
+      for ( std::size_t j = 0; j < b.d_.size(); ++j ) {
+        Digit t = a.d_[i] * b.d_[j] + rtn.d_[i + j] + carry;
+        rtn.d_[i + j] = t & Mask;
+        carry = t >> DigitBits;
+      } // for
+      rtn.d_[i + b.d_.size()] = carry;
+    } // for
+    rtn.trim();
+    return(rtn);
+  }
+
+  // Digits [begin, end) as a number
+  BigInt digits(std::size_t begin, std::size_t end) const {
+    BigInt rtn;
+    rtn.d_.assign(d_.begin() + begin, d_.begin() + end);
+    rtn.trim();
+    return(rtn);
+  }
+
+  // This times 2^(DigitBits * k)
+  BigInt shifted(std::size_t k) const {
+    BigInt rtn;
+    if ( !IsZero() ) {
+      rtn.d_.assign(k, 0);
+      rtn.d_.insert(rtn.d_.end(), d_.begin(), d_.end());
+    }
+    return(rtn);
+  }
+
+  static int compare(const BigInt& a, const BigInt& b) {
+    if ( a.d_.size() != b.d_.size() )
+      return(a.d_.size() < b.d_.size() ? -1 : 1);
+    for ( std::size_t i = a.d_.size(); i-- > 0; ) {
+      if ( a.d_[i] != b.d_[i] )
+        return(a.d_[i] < b.d_[i] ? -1 : 1);
+    } // for
+    return(0);
+  }
+
+  // In place division by a small divisor; returns the remainder
+  Digit divSmall(Digit divisor) {
+    Digit r = 0;
+    for ( std::size_t i = d_.size(); i-- > 0; ) {
+      Digit cur = (r << DigitBits) | d_[i];
+      d_[i] = cur / divisor;
+      r = cur % divisor;
+    } // for
+    trim();
+    return(r);
+  }
+
+  void trim() {
+    while ( !d_.empty() && 0 == d_.back() )
+      d_.pop_back();
+  }
+
+  std::vector<Digit> d_;
+};
+
+#endif // SATFACTOR_BIGINT_H
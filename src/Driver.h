@@ -0,0 +1,196 @@
+#ifndef SATFACTOR_DRIVER_H
+#define SATFACTOR_DRIVER_H
+
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+/*
+  Driver: what the tools that run other programs (portfolio, factorize and
+   bench) share: starting iencode, extract-sat and the solvers, waiting
+   for them under a SIGALRM timeout, timing them, and the bits of command
+   line handling that go with it.
+  A program is run directly (Start(), Run()); a solver command line goes
+   through the shell in its own process group (Launch()), so that Stop()
+   takes down whatever it started.  Waits return the wait status, or -1
+   once the alarm has fired.
+  Errors throw a std::string, as the tools using this header report them.
+*/
+struct Driver {
+  // Wall clock, in seconds
+  static double Seconds() {
+    struct timeval now;
+    gettimeofday(&now, 0);
+    return(now.tv_sec + now.tv_usec / 1e6);
+  }
+
+  // A positive decimal option value
+  static long Number(const std::string& str, const std::string& name) {
+    std::stringstream convert(str);
+    long value = 0;
+    if ( str.empty() || str.find_first_not_of("0123456789") != std::string::npos
+         || !(convert >> value) || value <= 0 )
+      throw(std::string("Bad value for ") + name + ": " + str);
+    return(value);
+  }
+
+  static std::vector<std::string> SplitWords(const std::string& s) {
+    std::vector<std::string> words;
+    std::stringstream in(s);
+    std::string word;
+    while ( in >> word )
+      words.push_back(word);
+    return(words);
+  }
+
+  // Every 'from' in 's' becomes 'to', as for {cnf} and {out}
+  static void Replace(std::string& s, const std::string& from, const std::string& to) {
+    for ( std::string::size_type pos = s.find(from); pos != std::string::npos;
+          pos = s.find(from, pos + to.size()) )
+      s.replace(pos, from.size(), to);
+  }
+
+  // Where the other tools are by default: next to this one
+  static std::string BinDir(const std::string& self) {
+    std::string::size_type slash = self.rfind('/');
+    return((slash == std::string::npos) ? "." : self.substr(0, slash));
+  }
+
+  // SIGALRM sets TimedOut(); without SA_RESTART, so that a wait sees EINTR
+  static void CatchAlarm() {
+    struct sigaction onAlarm;
+    onAlarm.sa_handler = OnAlarm;
+    sigemptyset(&onAlarm.sa_mask);
+    onAlarm.sa_flags = 0;
+    sigaction(SIGALRM, &onAlarm, 0);
+  }
+
+  // Times out after 'seconds' (none when 0)
+  static void Alarm(long seconds) {
+    TimedOut() = 0;
+    alarm(static_cast<unsigned int>(seconds));
+  }
+
+  static volatile std::sig_atomic_t& TimedOut() {
+    static volatile std::sig_atomic_t timedOut = 0;
+    return(timedOut);
+  }
+
+  // Starts a program, standard output going to 'outFile' when given
+  static pid_t Start(const std::string& program, const std::vector<std::string>& args,
+                     const std::string& outFile) {
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(program.c_str()));
+    for ( std::size_t i = 0; i < args.size(); ++i )
+      argv.push_back(const_cast<char*>(args[i].c_str()));
+    argv.push_back(0);
+
+    std::cout.flush();
+    pid_t pid = fork();
+    if ( pid < 0 )
+      throw(std::string("Unable to fork"));
+    else if ( 0 == pid ) {
+      if ( !outFile.empty() )
+        redirect(outFile);
+      execv(program.c_str(), &argv[0]);
+      std::cerr << "Unable to run " << program << std::endl;
+      _exit(127);
+    }
+    return(pid);
+  }
+
+  // Starts a command line through the shell in its own process group,
+  //  pinned to 'cpu' unless that is negative
+  static pid_t Launch(const std::string& command, const std::string& outFile, int cpu) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if ( pid < 0 )
+      throw(std::string("Unable to fork"));
+    else if ( 0 == pid ) {
+      setpgid(0, 0);
+      if ( cpu >= 0 ) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if ( 0 != sched_setaffinity(0, sizeof(set), &set) )
+          std::cerr << "Unable to pin a solver to CPU " << cpu << "; running it unpinned" << std::endl;
+      }
+      redirect(outFile);
+      std::string line = "exec " + command;
+      execl("/bin/sh", "sh", "-c", line.c_str(), static_cast<char*>(0));
+      _exit(127);
+    }
+    setpgid(pid, pid);
+    return(pid);
+  }
+
+  // Waits for 'pid'; its peak RSS goes to 'peakKB' when given.  -1 when the
+  //  alarm fires first, the process left running.
+  static int Wait(pid_t pid, long* peakKB = 0) {
+    int status = 0;
+    struct rusage usage;
+    while ( wait4(pid, &status, 0, &usage) < 0 ) {
+      if ( errno != EINTR )
+        throw(std::string("Lost track of a child process"));
+      else if ( TimedOut() )
+        return(-1);
+    } // while
+    if ( peakKB )
+      *peakKB = usage.ru_maxrss;
+    return(status);
+  }
+
+  // Start() and Wait(); a program still running when the alarm fires is
+  //  killed
+  static int Run(const std::string& program, const std::vector<std::string>& args,
+                 const std::string& outFile, long* peakKB = 0) {
+    pid_t pid = Start(program, args, outFile);
+    int status = Wait(pid, peakKB);
+    if ( -1 == status ) {
+      kill(pid, SIGKILL);
+      waitpid(pid, 0, 0);
+    }
+    return(status);
+  }
+
+  // A process group from Launch(): asked to stop, then killed
+  static void Stop(pid_t group) {
+    killpg(group, SIGTERM);
+    usleep(200000);
+    killpg(group, SIGKILL);
+    waitpid(group, 0, 0);
+  }
+
+  // True for a wait status of a normal exit with 'code'
+  static bool Exited(int status, int code) {
+    return(-1 != status && WIFEXITED(status) && code == WEXITSTATUS(status));
+  }
+
+private:
+  static void OnAlarm(int) {
+    TimedOut() = 1;
+  }
+
+  // In a child: standard output to 'outFile', or give up
+  static void redirect(const std::string& outFile) {
+    int fd = open(outFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if ( fd < 0 || dup2(fd, 1) < 0 )
+      _exit(127);
+    close(fd);
+  }
+};
+
+#endif // SATFACTOR_DRIVER_H
@@ -0,0 +1,261 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Input.h"
+#include "Metadata.h"
+
+
+/*
+    Lists every factorization that a WFF written by iencode admits, using one
+    incremental solver for the whole run.  After each model the factor pair
+    is printed and a clause blocking exactly that pair is added, and the
+    solver continues, keeping what it has learned, until it reports UNSAT.
+    With the default factor ordering each unordered pair shows up once.
+    A cube shard (iencode --cube-files) holds only the pairs of its cube.
+
+    The solver is any library implementing the standard IPASIR interface;
+    see the 'enumerate' target in the makefile.  IPASIR has no XOR
+    constraints, so 'x' lines are expanded into clauses on the way in.
+
+    The WFF may be compressed (iencode --compress) and its clauses may be
+    in the binary form of iencode --format=binary.
+*/
+
+
+extern "C" {
+  const char* ipasir_signature();
+  void* ipasir_init();
+  void ipasir_release(void* solver);
+  void ipasir_add(void* solver, int litOrZero);
+  int ipasir_solve(void* solver);
+  int ipasir_val(void* solver, int lit);
+}
+
+std::string Usage() {
+  std::string rtn = "enumerate-sat <WFF>";
+  rtn += "\n<WFF> is a SAT problem written by iencode (not iCNF), plain, binary";
+  rtn += "\n  or compressed with gzip, xz or zstd";
+  rtn += "\n  Every pair of factors is printed in binary, as extract-sat does.";
+  return(rtn);
+}
+
+// The IPASIR solver for the lifetime of main()
+struct Solver {
+  Solver() : solver_(ipasir_init())
+  { /* */ }
+
+  ~Solver() {
+    ipasir_release(solver_);
+  }
+
+  void Add(int lit) {
+    ipasir_add(solver_, lit);
+  }
+
+  // A constraint whose literals' XOR is true: one clause per assignment of
+  //  even parity, ruling it out
+  void AddXor(const std::vector<int>& lits) {
+    if ( lits.empty() || lits.size() > 20 )
+      throw(std::string("Unsupported XOR constraint size in WFF input file"));
+    for ( unsigned long set = 0; set < (1UL << lits.size()); ++set ) {
+      std::size_t ones = 0;
+      for ( std::size_t i = 0; i < lits.size(); ++i )
+        ones += (set >> i) & 1;
+      if ( ones % 2 )
+        continue;
+      for ( std::size_t i = 0; i < lits.size(); ++i )
+        Add(((set >> i) & 1) ? -lits[i] : lits[i]);
+      Add(0);
+    } // for
+  }
+
+  int Solve() {
+    return(ipasir_solve(solver_));
+  }
+
+  bool Value(int var) {
+    return(ipasir_val(solver_, var) > 0);
+  }
+
+  // The clauses of a 'p bincnf' WFF, from just after that line to the end
+  //  (see DimacsWriter in IEncode.cpp)
+  void AddBinary(std::FILE* in) {
+    std::vector<int> lits;
+    unsigned long prev = 0, value = 0;
+    int shift = 0, c = 0;
+    bool isXor = false, first = true;
+    while ( EOF != (c = std::getc(in)) ) {
+      value |= static_cast<unsigned long>(c & 0x7F) << shift;
+      shift += 7;
+      if ( c & 0x80 )
+        continue;
+      if ( 0 == value && first && !isXor ) { // an XOR constraint follows
+        isXor = true;
+      } else if ( 0 == value ) { // end of the constraint
+        if ( isXor )
+          AddXor(lits);
+        else {
+          for ( std::size_t i = 0; i < lits.size(); ++i )
+            Add(lits[i]);
+          Add(0);
+        }
+        lits.clear();
+        prev = 0;
+        isXor = false;
+        first = true;
+      } else {
+        prev += value;
+        int var = static_cast<int>(prev / 2);
+        lits.push_back((prev % 2) ? -var : var);
+        first = false;
+      }
+      value = 0;
+      shift = 0;
+    } // while
+    if ( !first || isXor || shift )
+      throw(std::string("Truncated binary clauses in WFF input file"));
+  }
+
+private:
+  Solver(const Solver&);
+  Solver& operator=(const Solver&);
+
+  void* solver_;
+};
+
+
+//========
+// main()
+//========
+int main(int argc, char* argv[]) {
+  try {
+    if ( argc == 2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help" ) ) {
+      std::cout << Usage() << std::endl;
+      return(EXIT_SUCCESS);
+    } else if ( argc != 2 ) {
+      throw(std::string("Wrong # arguments"));
+    }
+
+    Input factorFile(argv[1]);
+    if ( !factorFile.File() )
+      throw(std::string("Can't find WFF input file: ") + argv[1]);
+
+    // Header comments give each factor bit's variable (the 'c meta' block),
+    //  or in older files the factor widths, the factor bits coming first;
+    //  the clauses go straight to the solver
+    std::string toFind = "c half size = ", toFindWidths = "c factor widths = ";
+    std::string toFindShard = "c shard ", shard;
+    int widthA = -1, widthB = -1;
+    long shards = 0;
+    Metadata meta;
+    Solver solver;
+    std::string line;
+    while ( factorFile.GetLine(line) ) {
+      if ( line.empty() )
+        continue;
+      std::stringstream in(line);
+      if ( line[0] == 'c' ) {
+        if ( meta.Read(line) ) {
+          continue;
+        } else if ( line.find(toFind) == 0 ) {
+          std::stringstream(line.substr(toFind.size())) >> widthA;
+          widthB = widthA;
+        } else if ( line.find(toFindWidths) == 0 ) {
+          std::stringstream(line.substr(toFindWidths.size())) >> widthA >> widthB;
+        } else if ( line.find("c cube ") == 0 ) {
+          throw(std::string("A manifest has no clauses; give one of its shards"));
+        } else if ( line.find(toFindShard) == 0 ) { // "c shard i of K = ..."
+          std::string of;
+          if ( !(in.ignore(toFindShard.size()) >> shard >> of >> shards) || of != "of" )
+            throw(std::string("Bad shard line in WFF input file: ") + line);
+        }
+      } else if ( line.find("p bincnf") == 0 ) {
+        solver.AddBinary(factorFile.File());
+        break;
+      } else if ( line[0] == 'p' ) {
+        if ( line.find("cnf") == std::string::npos )
+          throw(std::string("Only CNF is supported: ") + line);
+      } else if ( line[0] == 'a' ) {
+        throw(std::string("iCNF assumptions are not supported; use a single WFF"));
+      } else if ( line[0] == 'x' ) {
+        std::vector<int> lits;
+        int lit;
+        in.ignore(1);
+        while ( in >> lit && lit )
+          lits.push_back(lit);
+        solver.AddXor(lits);
+      } else {
+        int lit;
+        while ( in >> lit )
+          solver.Add(lit);
+      }
+    } // while
+
+    if ( !meta.Complete() ) {
+      if ( widthA <= 0 || widthB <= 0 )
+        throw(std::string("Unable to find: '") + toFind + std::string("' in WFF input file"));
+      meta.widthA_ = widthA;
+      meta.widthB_ = widthB;
+      meta.Factor(true, 1, widthA);
+      meta.Factor(false, widthA + 1, widthB);
+    }
+    widthA = meta.widthA_;
+    widthB = meta.widthB_;
+
+    // Each factor bit: its variable, or 0 when forced (then 'fixed' holds it)
+    std::vector<long> vars(meta.varsA_);
+    std::vector<bool> fixed(meta.fixedA_);
+    vars.insert(vars.end(), meta.varsB_.begin(), meta.varsB_.end());
+    fixed.insert(fixed.end(), meta.fixedB_.begin(), meta.fixedB_.end());
+
+    long found = 0;
+    int result = 0;
+    while ( 10 == (result = solver.Solve()) ) {
+      std::string solution1, solution2;
+      std::vector<long> block;
+      for ( int idx = 0; idx < widthA + widthB; ++idx ) {
+        bool bit = vars[idx] ? solver.Value(vars[idx]) : fixed[idx];
+        if ( vars[idx] )
+          block.push_back(bit ? -vars[idx] : vars[idx]);
+        std::string& solution = (idx < widthA) ? solution1 : solution2;
+        solution.insert(solution.begin(), bit ? '1' : '0');
+      } // for
+
+      std::cout << "First Factor:  " << solution1 << std::endl;
+      std::cout << "Second Factor: " << solution2 << std::endl;
+      ++found;
+      if ( block.empty() ) { // nothing left to vary
+        result = 20;
+        break;
+      }
+      for ( std::size_t i = 0; i < block.size(); ++i )
+        solver.Add(block[i]);
+      solver.Add(0);
+    } // while
+
+    if ( 20 != result )
+      throw(std::string("The solver stopped without an answer"));
+    else if ( found )
+      std::cout << "Found " << found << " factorization(s) using " << ipasir_signature() << std::endl;
+    else if ( shards )
+      std::cout << "No Solution Found in shard " << shard << ": Number is PRIME only if all "
+                << shards << " shards are UNSAT" << std::endl;
+    else
+      std::cout << "No Solution Found: Number is PRIME" << std::endl;
+    return(EXIT_SUCCESS);
+  } catch(std::string& s) {
+    std::cerr << s << std::endl;
+    std::cerr << "use enumerate-sat -h for help" << std::endl;
+  } catch(std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  } catch(...) {
+    std::cerr << "Unknown runtime error" << std::endl;
+  }
+  return(EXIT_FAILURE);
+}
@@ -1,43 +1,52 @@
 #include <algorithm>
+#include <cctype>
 #include <cstddef>
+#include <cstdio>
+#include <cstdlib>
 #include <exception>
-#include <fstream>
 #include <iostream>
-#include <iterator>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "BigInt.h"
+#include "Input.h"
+#include "Metadata.h"
+
 
 /*
     An application of very limited use.  Can extract factors of number N
     as found by a sat solver whose input was the output of the ifactor
-    executable.  But, the solver's output solution must follow 1 or 2 below:
-    (1) Contain the syntax
+    executable.  The solver's output ('-' for standard input) is read in
+    a single pass and may be in any of these forms:
+    (1) SAT competition output:  's SATISFIABLE' (or 's UNSATISFIABLE')
+        and any number of 'v 1 -2 ... 0' lines; 'c' lines are skipped
+    (2) A MiniSat result file:  'SAT' (or 'UNSAT') then the literals
+    (3) A line containing
         solution = 1 -2 ...
-    Other information can be in the file, but the solution must look like
-    this, with no new lines.
-    (2) Just the solution, with no other information in the file
+    (4) Just the literals
          1 -2 ...
+    Other lines of solver chatter are skipped.  Literals may come in any
+    order, over any number of lines; only factor variables are kept.
+
+    If no literals and no verdict are found, this app will assume that the
+    WFF was unsatisfiable and report that N is a prime.  A cube shard (or
+    the manifest of iencode --cube-files) covers only part of the search:
+    its UNSAT is reported as such, N being prime only if every shard is.
+
+    When the WFF records N (a 'c N = ' comment, written by iencode), the
+    two factors are multiplied back together and must give N exactly.
 
-    If both are unfound, this app will assume that the WFF was
-    unsatisfiable and report that N is a prime.
+    Either file may be compressed with gzip, xz or zstd (iencode --compress);
+    it is recognized by its first bytes and read through the decompressor.
+    Only the WFF's header comments are read, so the binary clause format
+    (iencode --format=binary) is accepted as well.
 
     You can modify your solution file to have one of these formats, or you can 
     make adjustments in main() below to suit your solver's output needs.
 */
 
 
-struct ByLine : std::string {
-  friend std::istream& operator>>(std::istream &is, ByLine &toGet) {
-    std::getline(is, toGet);
-    return(is);
-  }
-};
-
-std::vector<std::string> SplitString(const std::string& s, char delim);
-void RemoveFrontSpace(std::string&);
-
 std::string Error() {
   std::string rtn = "Bad Input: Expect 2 arguments";
   rtn += "\nArg1 = WFF input file";
@@ -47,125 +56,264 @@ std::string Error() {
 }
 
 std::string Usage() {
-  std::string rtn = "extract-sat <WFF> <SAT-Solution>";
+  std::string rtn = "extract-sat [--base=2|10|16] <WFF> <SAT-Solution>";
   rtn += "\n<WFF> is the original file of the solved SAT problem";
   rtn += "\n<SAT-Solution> is the SAT problem's solution file";
-  rtn += "\n  Note that <SAT-Solution> must contain only a list of integers:";
+  rtn += "\n  ('-' for standard input): competition 's'/'v' lines, a MiniSat";
+  rtn += "\n  result file, 'solution = 1 -2 ...' or just the literals:";
   rtn += "\n    Example:  1 -2 3 4 -5 ...";
+  rtn += "\n--base prints the factors in binary (the default), decimal or hex";
   return(rtn);
 }
 
+// The solver's answer, streamed through a large buffer: a value is kept
+//  only for the factor variables 'vars', indexed directly by variable,
+//  whatever the model's size
+struct Model {
+  Model(std::FILE* file, const std::vector<long>& vars)
+    : file_(file), buffer_(1 << 20), pos_(0), end_(0), values_(), verdict_(None), literals_(false) {
+    values_.assign(vars.empty() ? 1 : *std::max_element(vars.begin(), vars.end()) + 1, Unwanted);
+    for ( std::size_t i = 0; i < vars.size(); ++i )
+      values_[vars[i]] = 0;
+    read();
+  }
+
+  // Anything but an explicit UNSAT, given some literals
+  bool Satisfiable() const {
+    if ( verdict_ == Unknown )
+      throw(std::string("The solver gave no answer (UNKNOWN/INDET)"));
+    return(verdict_ != Unsat && (literals_ || verdict_ == Sat));
+  }
+
+  bool Value(long var) const {
+    if ( 0 == values_[var] )
+      throw(std::string("Solution does not assign every factor variable"));
+    return(values_[var] > 0);
+  }
+
+private:
+  enum Verdict { None, Sat, Unsat, Unknown };
+  enum { Unwanted = 2 };
+
+  void read() {
+    std::string word;
+    while ( more() ) {
+      if ( !token(word) ) // blank line
+        continue;
+      else if ( word == "s" ) {
+        token(word);
+        verdict(word);
+        skipLine();
+      } else if ( word == "SAT" || word == "UNSAT" || word == "INDET" ) {
+        verdict(word);
+        skipLine();
+      } else if ( word == "v" ) {
+        literalLine();
+      } else if ( word == "solution" ) {
+        if ( token(word) && word == "=" )
+          literalLine();
+        else
+          skipLine();
+      } else if ( word[0] == '-' || (word[0] >= '0' && word[0] <= '9') ) {
+        literal(word);
+        literalLine();
+      } else { // 'c' comments and other solver chatter
+        skipLine();
+      }
+    } // while
+  }
+
+  void verdict(const std::string& word) {
+    if ( word == "SATISFIABLE" || word == "SAT" )
+      verdict_ = Sat;
+    else if ( word == "UNSATISFIABLE" || word == "UNSAT" )
+      verdict_ = Unsat;
+    else
+      verdict_ = Unknown;
+  }
+
+  void literalLine() {
+    std::string word;
+    while ( token(word) )
+      literal(word);
+  }
+
+  void literal(const std::string& word) {
+    std::size_t i = (word[0] == '-') ? 1 : 0;
+    if ( i == word.size() || word.find_first_not_of("0123456789", i) != std::string::npos )
+      throw(std::string("Bad literal in solution: ") + word);
+    long var = 0;
+    for ( ; i < word.size() && var < static_cast<long>(values_.size()); ++i )
+      var = var * 10 + (word[i] - '0');
+    if ( var > 0 && var < static_cast<long>(values_.size()) && values_[var] != Unwanted )
+      values_[var] = (word[0] == '-') ? -1 : 1;
+    literals_ = literals_ || var > 0;
+  }
+
+  bool more() {
+    if ( pos_ == end_ ) {
+      end_ = std::fread(&buffer_[0], 1, buffer_.size(), file_);
+      pos_ = 0;
+    }
+    return(pos_ < end_);
+  }
+
+  // The next word on this line; false (the newline consumed) at its end
+  bool token(std::string& word) {
+    word.clear();
+    while ( more() && (buffer_[pos_] == ' ' || buffer_[pos_] == '\t' || buffer_[pos_] == '\r') )
+      ++pos_;
+    if ( !more() )
+      return(false);
+    else if ( buffer_[pos_] == '\n' ) {
+      ++pos_;
+      return(false);
+    }
+    while ( more() && !std::isspace(static_cast<unsigned char>(buffer_[pos_])) )
+      word += buffer_[pos_++];
+    return(true);
+  }
+
+  void skipLine() {
+    while ( more() && buffer_[pos_++] != '\n' )
+      ;
+  }
+
+  std::FILE* file_;
+  std::vector<char> buffer_;
+  std::size_t pos_, end_;
+  std::vector<int> values_;
+  Verdict verdict_;
+  bool literals_;
+};
+
 
 //========
 // main()
 //========
 int main(int argc, char* argv[]) {
   try {
-    if ( argc == 2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help" ) ) {
-      std::cout << Usage() << std::endl;
-      return(EXIT_SUCCESS);
-    } else if ( argc != 3 ) {
+    std::string base = "2";
+    std::vector<std::string> args;
+    for ( int i = 1; i < argc; ++i ) {
+      std::string arg = argv[i];
+      if ( arg == "-h" || arg == "--help" ) {
+        std::cout << Usage() << std::endl;
+        return(EXIT_SUCCESS);
+      } else if ( arg.find("--base=") == 0 ) {
+        base = arg.substr(7);
+        if ( base != "2" && base != "10" && base != "16" )
+          throw(std::string("Bad value for --base: ") + base);
+      } else {
+        args.push_back(arg);
+      }
+    } // for
+    if ( args.size() != 2 )
       throw(std::string("Wrong # arguments"));
-    } else if ( std::string(argv[2]) == "-h" || std::string(argv[2]) == "--help" ) {
-      std::cout << Usage() << std::endl;
-      return(EXIT_SUCCESS);
-    }
   
-    std::ifstream factorFile(argv[1]), solutionFile(argv[2]);
-    if ( !factorFile ) {
-      throw(std::string("Can't find WFF input file: ") + argv[1]);
-    } else if ( !solutionFile ) {
-      throw(std::string("Can't find solution file: ") + argv[2]);
-    }
+    Input factorFile(args[0]);
+    if ( !factorFile.File() )
+      throw(std::string("Can't find WFF input file: ") + args[0]);
   
-    // Read in WFF input file; determine its "half size"
-    std::string toFind = "c half size = ";
-    int multSize = -1;
-    ByLine tmp;
-    while ( factorFile >> tmp ) {
-      std::string::size_type pos = tmp.find(toFind);
-      if ( pos != std::string::npos ) {
+    // Read in WFF input file's header.  The 'c meta' block gives each
+    //  factor bit's variable (see Metadata.h).  Files without it have their
+    //  "half size", or the width of each factor, the factor bits coming first.
+    std::string toFind = "c half size = ", toFindWidths = "c factor widths = ";
+    std::string toFindN = "c N = ", number;
+    std::string toFindCube = "c cube ", toFindShard = "c shard ", shard;
+    int widthA = -1, widthB = -1;
+    long shards = 0;
+    Metadata meta;
+    std::string tmp;
+    while ( factorFile.GetLine(tmp) ) {
+      std::string::size_type pos = tmp.find(toFind), posW = tmp.find(toFindWidths);
+      if ( !tmp.empty() && tmp[0] == 'p' ) {
+        break;
+      } else if ( meta.Read(tmp) ) {
+        continue;
+      } else if ( tmp.find(toFindN) == 0 ) {
+        number = tmp.substr(toFindN.size());
+      } else if ( tmp.find(toFindCube) == 0 ) { // a manifest: one line per shard
+        ++shards;
+      } else if ( tmp.find(toFindShard) == 0 ) { // "c shard i of K = ..."
+        std::stringstream convert(tmp.substr(toFindShard.size()));
+        std::string of;
+        if ( !(convert >> shard >> of >> shards) || of != "of" )
+          throw(std::string("Bad shard line in WFF input file: ") + tmp);
+      } else if ( pos != std::string::npos ) {
         pos += toFind.size();
         std::string stmp = tmp.substr(pos);
         if ( stmp.find_first_not_of("0123456789") != std::string::npos ) {
           throw(std::string("Could not find half size value in WFF input file"));
         }
         std::stringstream convert(stmp);
-        convert >> multSize;
-        break;
+        convert >> widthA;
+        widthB = widthA;
+      } else if ( posW != std::string::npos ) {
+        posW += toFindWidths.size();
+        std::string stmp = tmp.substr(posW);
+        std::stringstream convert(stmp);
+        if ( stmp.find_first_not_of("0123456789 ") != std::string::npos || !(convert >> widthA >> widthB) ) {
+          throw(std::string("Could not find factor widths in WFF input file"));
+        }
       }
     } // while
 
-    if ( multSize <= 0 )
-      throw(std::string("Unable to find: '") + toFind + std::string("' in WFF input file"));
+    if ( !meta.Complete() ) {
+      if ( widthA <= 0 || widthB <= 0 )
+        throw(std::string("Unable to find: '") + toFind + std::string("' in WFF input file"));
+      meta.widthA_ = widthA;
+      meta.widthB_ = widthB;
+      meta.Factor(true, 1, widthA);
+      meta.Factor(false, widthA + 1, widthB);
+    } else if ( !number.empty() && !meta.hash_.empty() && Metadata::Hash(number) != meta.hash_ ) {
+      throw(std::string("N does not match its hash in WFF input file"));
+    }
+
+    // The factor variables, for a direct-indexed lookup into the model
+    std::vector<long> vars;
+    for ( std::size_t idx = 0; idx < meta.varsA_.size(); ++idx ) {
+      if ( meta.varsA_[idx] )
+        vars.push_back(meta.varsA_[idx]);
+    } // for
+    for ( std::size_t idx = 0; idx < meta.varsB_.size(); ++idx ) {
+      if ( meta.varsB_[idx] )
+        vars.push_back(meta.varsB_[idx]);
+    } // for
 
-    // Read in solution file; find "solution ="; using the "half size", 
-    // construct the two found factors and display them (in binary)
-    std::vector<int> mult1, mult2;
-    std::vector<std::string> fileContents;
-    std::istream_iterator<ByLine> eof, sf(solutionFile);
-    std::copy(sf, eof, std::back_inserter(fileContents));
-    std::vector<std::string>::iterator i = fileContents.begin();
-    toFind = "solution =";
+    // Read the solution in one pass, keeping only the factor variables;
+    //  using the factor widths, construct the two found factors
+    Input solutionFile(args[1]);
+    if ( !solutionFile.File() )
+      throw(std::string("Can't find solution file: ") + args[1]);
+    Model model(solutionFile.File(), vars);
     std::string solution1, solution2;
-    while ( i != fileContents.end() ) {
-      std::string stmp = *i;
-      RemoveFrontSpace(stmp);
-      std::string::size_type pos = stmp.find(toFind);
-      if ( 1 == fileContents.size() && pos == std::string::npos ) {
-        std::string nums = " -0123456789";
-        if ( !stmp.empty() && stmp.find_first_not_of(nums) == std::string::npos ) {
-          pos = 0;
-          toFind = "";
-        }
-      }
+    if ( model.Satisfiable() ) {
+      for ( long idx = meta.widthA_; idx-- > 0; )
+        solution1 += (meta.varsA_[idx] ? model.Value(meta.varsA_[idx]) : meta.fixedA_[idx]) ? '1' : '0';
+      for ( long idx = meta.widthB_; idx-- > 0; )
+        solution2 += (meta.varsB_[idx] ? model.Value(meta.varsB_[idx]) : meta.fixedB_[idx]) ? '1' : '0';
+    }
 
-      if ( pos != std::string::npos ) {
-        pos += toFind.size();
-        stmp = stmp.substr(pos);
-        std::vector<std::string> split = SplitString(stmp, ' ');
-        if ( split.size() < static_cast<std::size_t>(multSize * 2) )
-          throw(std::string("Size of 'Multiple' given > # literals in solution??? - something is wrong"));
-  
-        int val;
-        std::stringstream toConvert(stmp);
-        for ( int idx = 0; idx < multSize; ++idx ) {
-          toConvert >> val;
-          mult1.push_back(val);
-        } // for
-  
-        for ( int idx = multSize; idx < multSize * 2; ++idx ) {
-          toConvert >> val;
-          mult2.push_back(val);
-        } // for
-  
-        std::reverse(mult1.begin(), mult1.end());
-        std::reverse(mult2.begin(), mult2.end());
-        std::vector<int>::iterator iter = mult1.begin();
-        while ( iter != mult1.end() ) {
-          if ( *iter > 0 )
-            solution1 += "1";
-          else
-            solution1 += "0";
-          ++iter;
-        } // while
-  
-        iter = mult2.begin();
-        while ( iter != mult2.end() ) {
-          if ( *iter > 0 )
-            solution2 += "1";
-          else
-            solution2 += "0";
-          ++iter;
-        } // while
-        break;
-      }
-      ++i;
-    } // while
-  
     if ( !solution1.empty() ) {
+      BigInt a = BigInt::FromBinary(solution1), b = BigInt::FromBinary(solution2);
+      if ( !number.empty() && a * b != BigInt::FromDecimal(number) ) {
+        std::cerr << "The factors found do not multiply to N = " << number << std::endl;
+        std::cerr << "First Factor:  " << solution1 << std::endl;
+        std::cerr << "Second Factor: " << solution2 << std::endl;
+        return(EXIT_FAILURE);
+      } else if ( base == "10" ) {
+        solution1 = a.ToDecimal();
+        solution2 = b.ToDecimal();
+      } else if ( base == "16" ) {
+        solution1 = a.ToHex();
+        solution2 = b.ToHex();
+      }
       std::cout << "First Factor:  " << solution1 << std::endl;
       std::cout << "Second Factor: " << solution2 << std::endl;
+    } else if ( shards ) {
+      std::cout << "No Solution Found in " << (shard.empty() ? "this shard" : "shard " + shard)
+                << ": Number is PRIME only if all " << shards << " shards are UNSAT" << std::endl;
     } else {
       std::cout << "No Solution Found: Number is PRIME" << std::endl;
     }
@@ -181,86 +329,3 @@ int main(int argc, char* argv[]) {
   }
   return(EXIT_FAILURE);
 }
-
-
-//===============================
-// simple string cleanup helpers
-//===============================
-void RemoveBackSpace(std::string& s) {
-  bool done = false;
-  while ( ! done ) {
-    if ( s.empty() ) break;
-    if ( s[s.size()-1] == ' ' ) {
-      if ( s.size() > 1 )
-        s = s.substr(0, s.size()-1);
-      else
-        s = "";
-    }
-    else 
-      break;
-  } // while
-}
-
-void RemoveFrontSpace(std::string& s) {
-  bool done = false;
-  while ( ! done ) {
-    if ( s.empty() ) 
-      break;
-    if ( s[0] == ' ' ) 
-      s = s.substr(1);
-    else 
-      break;
-  } // while
-}
-
-void RemoveFrontBackSpace(std::string& s) {
-  RemoveBackSpace(s);
-  RemoveFrontSpace(s);
-}
-
-void RemoveTabs(std::string& s) {
-  bool done = false;
-  std::string::size_type idx = 0;
-  while ( ! done ) {
-    if ( s.empty() ) break;
-    if ( s[idx] == '\t' ) {
-      s = s.substr(0, idx) + s.substr(idx+1);
-      idx = 0;
-    }
-    if ( ++idx == s.size() ) break;
-  } // while
-}
-
-std::vector<std::string> SplitString(const std::string& s, char delim) {
-  // Split string around each delim instance
-  std::vector<std::string> toRtn;
-  if ( s.empty() )
-    return(toRtn);
-    
-  std::size_t j = 0, i = 0;
-  for ( ; i < s.size(); ) {
-    if ( s[i] == delim ) {
-      if ( 0 != i ) 
-        toRtn.push_back(s.substr(j, i-j));
-      j = ++i;         
-    }
-    else
-      ++i;
-  } // for
-  if ( j != i )
-    toRtn.push_back(s.substr(j));
- 
-  // Remove leading/trailing spaces, any tabs and any newlines
-  std::vector<std::string>::iterator k = toRtn.begin();
-  while ( k != toRtn.end() ) {
-    RemoveTabs(*k);
-    RemoveFrontBackSpace(*k);
-    if ( ! k->empty() )
-      ++k;
-    else {
-      toRtn.erase(k);
-      k = toRtn.begin();
-    }
-  } // while
-  return(toRtn);
-}
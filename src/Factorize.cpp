@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "BigInt.h"
+#include "Driver.h"
+
+
+/*
+    Factors N completely.  Small primes come off by trial division, and a
+    Miller-Rabin test sends every prime cofactor straight to the result, so
+    the SAT stage only ever sees composites.  Each composite is split by the
+    portfolio driver (iencode, the solvers, extract-sat); the two pieces go
+    back through the same checks, and up to --jobs composites are split at
+    once, each in its own process.
+
+    Primes already found, in this run or in the --cache file from earlier
+    runs, are divided out of every new piece before it is tested, and the
+    same composite is never split twice.
+*/
+
+
+struct Options {
+  Options() : jobs_(1), trial_(10000), timeout_(0), base_(2)
+  { /* */ }
+
+  std::string number_, binDir_, cache_;
+  std::vector<std::string> solvers_, variants_;
+  long jobs_, trial_, timeout_, base_;
+};
+
+// A composite being split by a portfolio run; 'count' is how many times
+//  it occurs in N
+struct Split {
+  Split(const BigInt& n, long count) : n_(n), count_(count), pid_(-1)
+  { /* */ }
+
+  BigInt n_;
+  long count_;
+  pid_t pid_;
+  std::string out_;
+};
+
+std::string Usage() {
+  std::string rtn = "factorize [options] --solver <command> ... <integer>";
+  rtn += "\nExample: factorize --solver kissat 1111000011110001";
+  rtn += "\n  Prints every prime factor of N, with multiplicity, in --base.";
+  rtn += "\n\nOptions:";
+  rtn += "\n  --base=2|10|16  read N and print its factors in binary (the";
+  rtn += "\n                  default), decimal or hexadecimal; a 0x prefix";
+  rtn += "\n                  always means hexadecimal";
+  rtn += "\n  --solver CMD    a solver command line for portfolio, repeatable";
+  rtn += "\n  --variant OPTS  iencode options for portfolio, repeatable";
+  rtn += "\n  --jobs J        split up to J composites at once (default 1)";
+  rtn += "\n  --trial B       trial division by primes below B (default 10000,";
+  rtn += "\n                  at most 65535)";
+  rtn += "\n  --timeout S     per portfolio run";
+  rtn += "\n  --cache FILE    primes known from earlier runs, one per line in";
+  rtn += "\n                  binary; new ones are appended";
+  rtn += "\n  --bin DIR       where portfolio, iencode and extract-sat are";
+  rtn += "\n                  (default: next to factorize)";
+  return(rtn);
+}
+
+Options ParseArgs(int argc, char* argv[]) {
+  Options opts;
+  opts.binDir_ = Driver::BinDir(argv[0]);
+  for ( int i = 1; i < argc; ++i ) {
+    std::string arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if ( arg == "--solver" && hasValue )
+      opts.solvers_.push_back(argv[++i]);
+    else if ( arg == "--variant" && hasValue )
+      opts.variants_.push_back(argv[++i]);
+    else if ( arg == "--jobs" && hasValue )
+      opts.jobs_ = Driver::Number(argv[++i], arg);
+    else if ( arg == "--trial" && hasValue )
+      opts.trial_ = Driver::Number(argv[++i], arg);
+    else if ( arg == "--timeout" && hasValue )
+      opts.timeout_ = Driver::Number(argv[++i], arg);
+    else if ( arg == "--cache" && hasValue )
+      opts.cache_ = argv[++i];
+    else if ( arg == "--bin" && hasValue )
+      opts.binDir_ = argv[++i];
+    else if ( arg.find("--base=") == 0 ) {
+      std::string base = arg.substr(7);
+      if ( base != "2" && base != "10" && base != "16" )
+        throw(std::string("Bad value for --base: ") + base);
+      opts.base_ = Driver::Number(base, "--base");
+    }
+    else if ( arg.empty() || arg[0] == '-' || !opts.number_.empty() )
+      throw(std::string("Unexpected argument: ") + arg);
+    else
+      opts.number_ = arg;
+  } // for
+
+  if ( opts.number_.empty() || opts.solvers_.empty() )
+    throw(std::string("Need at least one --solver and the number to factor"));
+  else if ( opts.trial_ > 65535 )
+    throw(std::string("Bad value for --trial: at most 65535"));
+  return(opts);
+}
+
+// N in the --base given, as iencode reads it; a 0x prefix is always hex
+BigInt ReadNumber(const std::string& str, long base) {
+  if ( str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X') )
+    return(BigInt::FromHex(str.substr(2)));
+  else if ( 10 == base )
+    return(BigInt::FromDecimal(str));
+  else if ( 16 == base )
+    return(BigInt::FromHex(str));
+  return(BigInt::FromBinary(str));
+}
+
+std::string WriteNumber(const BigInt& n, long base) {
+  if ( 10 == base )
+    return(n.ToDecimal());
+  else if ( 16 == base )
+    return(n.ToHex());
+  return(n.ToBinary());
+}
+
+std::vector<BigInt::Digit> SmallPrimes(long bound) {
+  std::vector<bool> sieve(bound, true);
+  std::vector<BigInt::Digit> primes;
+  for ( long p = 2; p < bound; ++p ) {
+    if ( !sieve[p] )
+      continue;
+    primes.push_back(p);
+    for ( long k = p * p; k < bound; k += p )
+      sieve[k] = false;
+  } // for
+  return(primes);
+}
+
+// Runs portfolio on 'n' in the background, its output going to 'outFile'
+pid_t LaunchSplit(const Options& opts, const BigInt& n, const std::string& outFile) {
+  std::vector<std::string> args;
+  args.push_back("--bin");
+  args.push_back(opts.binDir_);
+  for ( std::size_t i = 0; i < opts.solvers_.size(); ++i ) {
+    args.push_back("--solver");
+    args.push_back(opts.solvers_[i]);
+  } // for
+  for ( std::size_t i = 0; i < opts.variants_.size(); ++i ) {
+    args.push_back("--variant");
+    args.push_back(opts.variants_[i]);
+  } // for
+  if ( opts.timeout_ ) {
+    std::stringstream t;
+    t << opts.timeout_;
+    args.push_back("--timeout");
+    args.push_back(t.str());
+  }
+  if ( opts.jobs_ > 1 )
+    args.push_back("--no-pin"); // concurrent portfolios would share CPUs
+  args.push_back(n.ToBinary());
+  return(Driver::Start(opts.binDir_ + "/portfolio", args, outFile));
+}
+
+// The two factors portfolio printed, through extract-sat
+bool ReadSplit(const std::string& outFile, BigInt& a, BigInt& b) {
+  std::ifstream in(outFile.c_str());
+  std::string line, first = "First Factor:  ", second = "Second Factor: ";
+  bool gotA = false, gotB = false;
+  while ( std::getline(in, line) ) {
+    if ( line.find(first) == 0 ) {
+      a = BigInt::FromBinary(line.substr(first.size()));
+      gotA = true;
+    } else if ( line.find(second) == 0 ) {
+      b = BigInt::FromBinary(line.substr(second.size()));
+      gotB = true;
+    }
+  } // while
+  return(gotA && gotB);
+}
+
+// Everything known about N: its primes so far, and composites still to split
+struct Factorization {
+  Factorization(const std::vector<BigInt::Digit>& small, const std::set<BigInt>& known)
+    : small_(small), known_(known)
+  { /* */ }
+
+  // 'count' copies of n: small and known primes come off, a prime remainder
+  //  is done, and a composite one waits for the SAT stage
+  void Add(BigInt n, long count) {
+    for ( std::size_t i = 0; i < small_.size() && BigInt(1) < n; ++i ) {
+      while ( 0 == n.Mod(small_[i]) ) {
+        primes_.insert(primes_.end(), count, BigInt(small_[i]));
+        n = n / BigInt(small_[i]);
+      } // while
+    } // for
+    for ( std::set<BigInt>::const_iterator p = known_.begin(); p != known_.end() && BigInt(1) < n; ++p ) {
+      while ( (n % *p).IsZero() ) {
+        primes_.insert(primes_.end(), count, *p);
+        n = n / *p;
+      } // while
+    } // for
+    if ( !(BigInt(1) < n) )
+      return;
+    else if ( n.IsProbablePrime() ) {
+      primes_.insert(primes_.end(), count, n);
+      known_.insert(n);
+      return;
+    }
+
+    for ( std::size_t i = 0; i < splits_.size(); ++i ) {
+      if ( splits_[i].n_ == n ) {
+        splits_[i].count_ += count;
+        return;
+      }
+    } // for
+    splits_.push_back(Split(n, count));
+  }
+
+  std::vector<BigInt::Digit> small_;
+  std::set<BigInt> known_;
+  std::vector<BigInt> primes_;
+  std::vector<Split> splits_;
+};
+
+
+//========
+// main()
+//========
+int main(int argc, char* argv[]) {
+  std::vector<std::string> files;
+  try {
+    if ( argc == 2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help") ) {
+      std::cout << Usage() << std::endl;
+      return(EXIT_SUCCESS);
+    }
+    Options opts = ParseArgs(argc, argv);
+    BigInt n = ReadNumber(opts.number_, opts.base_);
+    if ( n.IsZero() )
+      throw(std::string("Zero has no factorization"));
+
+    // A cached entry is trusted only once it is seen to be prime: a stale
+    //  or edited line would otherwise be printed as a prime factor
+    std::set<BigInt> cached;
+    if ( !opts.cache_.empty() ) {
+      std::ifstream cache(opts.cache_.c_str());
+      std::string line;
+      for ( long lineNo = 1; std::getline(cache, line); ++lineNo ) {
+        std::string::size_type b = line.find_first_not_of(" \t\r"), e = line.find_last_not_of(" \t\r");
+        if ( b == std::string::npos )
+          continue;
+        std::stringstream where;
+        where << opts.cache_ << ":" << lineNo << ": ";
+        line = line.substr(b, e - b + 1);
+        if ( line.find_first_not_of("01") != std::string::npos )
+          throw(where.str() + "not a binary number: " + line);
+        BigInt p = BigInt::FromBinary(line);
+        if ( !p.IsProbablePrime() )
+          throw(where.str() + "not a prime: " + line);
+        cached.insert(p);
+      } // for
+    }
+
+    Factorization f(SmallPrimes(opts.trial_), cached);
+    f.Add(n, 1);
+
+    // Keep up to 'jobs' portfolio runs going until no composite is left
+    std::stringstream base;
+    base << "/tmp/factorize-" << getpid();
+    long running = 0, launched = 0;
+    while ( true ) {
+      for ( std::size_t i = 0; i < f.splits_.size() && running < opts.jobs_; ++i ) {
+        if ( f.splits_[i].pid_ > 0 )
+          continue;
+        std::stringstream name;
+        name << base.str() << "-" << launched++ << ".out";
+        f.splits_[i].out_ = name.str();
+        files.push_back(name.str());
+        f.splits_[i].pid_ = LaunchSplit(opts, f.splits_[i].n_, name.str());
+        ++running;
+      } // for
+      if ( 0 == running )
+        break;
+
+      int status = 0;
+      pid_t pid = waitpid(-1, &status, 0);
+      if ( pid < 0 )
+        continue;
+      for ( std::size_t i = 0; i < f.splits_.size(); ++i ) {
+        if ( f.splits_[i].pid_ != pid )
+          continue;
+        Split done = f.splits_[i];
+        f.splits_.erase(f.splits_.begin() + i);
+        --running;
+        BigInt a, b;
+        if ( !ReadSplit(done.out_, a, b) || a * b != done.n_ || a == BigInt(1) || b == BigInt(1) )
+          throw(std::string("The SAT stage did not split composite ") + done.n_.ToBinary());
+        f.Add(a, done.count_);
+        f.Add(b, done.count_);
+        break;
+      } // for
+    } // while
+
+    std::sort(f.primes_.begin(), f.primes_.end());
+    for ( std::size_t i = 0; i < f.primes_.size(); ++i )
+      std::cout << "Prime Factor: " << WriteNumber(f.primes_[i], opts.base_) << std::endl;
+
+    if ( !opts.cache_.empty() ) {
+      std::ofstream cache(opts.cache_.c_str(), std::ios::app);
+      for ( std::set<BigInt>::const_iterator p = f.known_.begin(); p != f.known_.end(); ++p ) {
+        if ( !cached.count(*p) )
+          cache << p->ToBinary() << std::endl;
+      } // for
+    }
+    for ( std::size_t i = 0; i < files.size(); ++i )
+      std::remove(files[i].c_str());
+    return(EXIT_SUCCESS);
+  } catch(std::string& s) {
+    std::cerr << s << std::endl;
+    std::cerr << "use factorize -h for help" << std::endl;
+  } catch(std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  } catch(...) {
+    std::cerr << "Unknown runtime error" << std::endl;
+  }
+  for ( std::size_t i = 0; i < files.size(); ++i )
+    std::remove(files[i].c_str());
+  return(EXIT_FAILURE);
+}
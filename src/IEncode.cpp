@@ -11,37 +11,513 @@
 
 
 #include <algorithm>
+#include <climits>
+#include <cstdlib>
 #include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <exception>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <list>
-#include <set>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "BigInt.h"
+#include "Driver.h"
+#include "Metadata.h"
+
 
 enum { EndClause = 0 };
 
-struct Clause {
-  typedef std::set<long> LitType;
+namespace { // unnamed
+  bool BAD = false;
+} // unnamed
 
-  explicit Clause(const LitType& literals) : lits_(literals)
+/*
+  ClauseDB: every clause lives in one contiguous literal arena.  A clause is
+   described by its starting offset only; its length is the distance to the
+   next clause's offset (a sentinel offset closes the last clause).  Literals
+   are stored as fixed-width ints, which is what DIMACS solvers use anyway.
+  Clauses are built in place: Push() literals, then Close() which sorts them
+   and drops duplicates within that clause only (no per-clause allocations).
+  CloseXor() closes the pending literals as an XOR constraint instead (the
+   literals' XOR must be true), for solvers reading the 'x' extension.
+  With tagging on, each clause also records the gate output variable it
+   helps define (set through Define(); 0 for plain constraints), which is
+   what a polarity-based reduction needs to know.
+*/
+struct ClauseDB {
+  typedef int LitType;
+
+  ClauseDB() : lits_(), offsets_(1, 0), tagging_(false), define_(0)
   { /* */ }
 
-  operator LitType() const { return(lits_); }
+  void Tagging(bool on) {
+    tagging_ = on;
+  }
+
+  void Define(long var) {
+    define_ = static_cast<LitType>(var);
+  }
+
+  long Defines(std::size_t c) const {
+    return(defines_[c]);
+  }
+
+  void Push(long lit) {
+    if ( lit > INT_MAX || lit < -INT_MAX ) {
+      std::cerr << "ClauseDB::Push(): literal exceeds " << INT_MAX << std::endl;
+      throw(BAD);
+    }
+    lits_.push_back(static_cast<LitType>(lit));
+  }
+
+  void Close() {
+    std::vector<LitType>::iterator b = lits_.begin() + offsets_.back();
+    if ( lits_.end() - b > 4 )
+      std::sort(b, lits_.end());
+    else { // short clauses: insertion sort
+      for ( std::vector<LitType>::iterator i = b; i != lits_.end(); ++i ) {
+        for ( std::vector<LitType>::iterator j = i; j != b && *j < *(j-1); --j )
+          std::iter_swap(j, j-1);
+      } // for
+    }
+    lits_.erase(std::unique(b, lits_.end()), lits_.end());
+    offsets_.push_back(lits_.size());
+    if ( tagging_ )
+      defines_.push_back(define_);
+    if ( !xors_.empty() )
+      xors_.push_back(false);
+  }
+
+  void CloseXor() {
+    std::sort(lits_.begin() + offsets_.back(), lits_.end());
+    offsets_.push_back(lits_.size());
+    if ( tagging_ )
+      defines_.push_back(define_);
+    xors_.resize(Size(), false);
+    xors_.back() = true;
+  }
+
+  bool IsXor(std::size_t c) const {
+    return(c < xors_.size() && xors_[c]);
+  }
+
+  // Drops every clause c with !keep[c], preserving the order of the rest
+  void Compact(const std::vector<bool>& keep) {
+    std::size_t to = 0, next = 0;
+    for ( std::size_t c = 0; c < Size(); ++c ) {
+      std::size_t from = offsets_[c], end = offsets_[c+1];
+      if ( !keep[c] )
+        continue;
+      offsets_[next] = to;
+      if ( tagging_ )
+        defines_[next] = defines_[c];
+      if ( !xors_.empty() )
+        xors_[next] = xors_[c];
+      ++next;
+      for ( ; from != end; ++from )
+        lits_[to++] = lits_[from];
+    } // for
+    offsets_[next] = to;
+    offsets_.resize(next + 1);
+    lits_.resize(to);
+    if ( tagging_ )
+      defines_.resize(next);
+    if ( !xors_.empty() )
+      xors_.resize(next);
+  }
+
+  std::size_t Size() const {
+    return(offsets_.size() - 1);
+  }
+
+  std::size_t Literals() const {
+    return(lits_.size());
+  }
+
+  const LitType* Begin(std::size_t c) const {
+    return(&lits_[0] + offsets_[c]);
+  }
+
+  const LitType* End(std::size_t c) const {
+    return(&lits_[0] + offsets_[c+1]);
+  }
+
+  // Takes other's clauses after these, in order, as if closed here
+  void Append(const ClauseDB& other) {
+    std::size_t before = Size(), base = lits_.size();
+    lits_.insert(lits_.end(), other.lits_.begin(), other.lits_.end());
+    for ( std::size_t c = 1; c < other.offsets_.size(); ++c )
+      offsets_.push_back(base + other.offsets_[c]);
+    if ( tagging_ )
+      defines_.insert(defines_.end(), other.defines_.begin(), other.defines_.end());
+    if ( !xors_.empty() || !other.xors_.empty() ) {
+      xors_.resize(before, false);
+      for ( std::size_t c = 0; c < other.Size(); ++c )
+        xors_.push_back(other.IsXor(c));
+    }
+  }
+
+  void Swap(ClauseDB& other) {
+    lits_.swap(other.lits_);
+    offsets_.swap(other.offsets_);
+    std::swap(tagging_, other.tagging_);
+    std::swap(define_, other.define_);
+    defines_.swap(other.defines_);
+    xors_.swap(other.xors_);
+  }
+
+  void Clear() {
+    lits_.clear();
+    offsets_.assign(1, 0);
+    defines_.clear();
+    xors_.clear();
+  }
+
+private:
+  std::vector<LitType> lits_;
+  std::vector<std::size_t> offsets_;
+  bool tagging_;
+  LitType define_;
+  std::vector<LitType> defines_;
+  std::vector<bool> xors_;
+};
+
+
+/*
+  GateStyle: per-run choices for how gates become clauses
+    halfAdders_ - adders with no carry-in are 7-clause half adder cells, not
+                  FullAdders with the carry-in dropped, and the array
+                  multiplier no longer pads its first row with a zero var
+    strong_     - adders also get the redundant clauses tying sum and carry
+                  together (s&c -> all inputs set, !s&!c -> none set), which
+                  lets unit propagation see more
+    polarity_   - Plaisted-Greenbaum: after construction, keep only the
+                  implication direction(s) of each gate that some remaining
+                  clause actually relies on
+    xor_        - adder sum bits are native XOR constraints ('x' lines) for
+                  solvers with Gaussian elimination; carries stay CNF
+*/
+struct GateStyle {
+  GateStyle() : halfAdders_(false), strong_(false), polarity_(false),
+                xor_(false)
+  { /* */ }
+
+  bool halfAdders_, strong_, polarity_, xor_;
+};
+
+/*
+  EncoderStats: what the multiplier's construction produced, by component,
+   for iencode --stats.  Every clause, its literals, and every variable a
+   component numbers are counted once, under the component building them:
+     AndGates     - partial products (makeAndEq), 1 variable each
+     FullAdders   - FullAdder cells (half adders included) outside a row
+     BitAdderRows - the array's ripple-carry rows, with the cells in them
+     Comparators  - the bounds: NotGreaterEqualN pairs or FactorOrder
+     Units        - unit clauses from setValue(), and constant variables
+     Other        - the factor bits, --modular, --residues, --truncate
+   'Count' is the number of gates, cells, rows, comparators or units.
+   Other's variables are whatever the rest leave of the total.
+  With --aig the gates' clauses are those Aig::Emit() writes, each node's
+   under the component that created it; variables stay as numbered.
+*/
+struct EncoderStats {
+  enum Part { AndGates, FullAdders, BitAdderRows, Comparators, Units, Other, Parts };
+
+  EncoderStats() {
+    for ( int p = 0; p < Parts; ++p )
+      count_[p] = vars_[p] = clauses_[p] = literals_[p] = 0;
+  }
+
+  static const char* Name(int p) {
+    const char* names[] = { "and gates", "full adders", "bitadder rows",
+                            "comparators", "units", "other" };
+    return(names[p]);
+  }
+
+  void Add(const EncoderStats& other) {
+    for ( int p = 0; p < Parts; ++p ) {
+      count_[p] += other.count_[p];
+      vars_[p] += other.vars_[p];
+      clauses_[p] += other.clauses_[p];
+      literals_[p] += other.literals_[p];
+    } // for
+  }
+
+  long count_[Parts], vars_[Parts], clauses_[Parts], literals_[Parts];
+};
+
+/*
+  DimacsWriter: buffered DIMACS output.  Integers are formatted by hand into
+   a large block which goes out with one fwrite() when full.
+  The 'p cnf' line is written either with counts known up front (Header()),
+   or as a fixed-width placeholder (Reserve()) that Finish() back-patches;
+   the latter needs a seekable output such as a regular file.  The spare
+   room goes into a 'c' line just ahead of the header, so that the 'p' line
+   itself comes out as it would from Header().
+  Binary(true) keeps the text comments but writes 'p bincnf' and compact
+   clauses: each literal becomes 2*var (+1 when negative), a clause's
+   values go out in ascending order as differences from the one before,
+   each as a varint (7 bits a byte, low first, high bit set on all but the
+   last), and a 0 ends the clause.  An XOR constraint starts with an extra
+   0; a clause cannot, its first value being at least 2.
+*/
+struct DimacsWriter {
+  explicit DimacsWriter(std::FILE* out, std::size_t blockSize = 1 << 20)
+    : out_(out), buf_(blockSize), pos_(0), headerAt_(-1), clauses_(0), binary_(false)
+  { /* */ }
+
+  void Binary(bool on) {
+    binary_ = on;
+  }
+
+  ~DimacsWriter() {
+    if ( pos_ )
+      std::fwrite(&buf_[0], 1, pos_, out_);
+  }
+
+  bool Seekable() const {
+    struct stat st;
+    if ( 0 != fstat(fileno(out_), &st) || !S_ISREG(st.st_mode) )
+      return(false);
+    return(-1 != std::ftell(out_));
+  }
+
+  void Comment(const std::string& text) {
+    put('c'); put(' ');
+    for ( std::size_t i = 0; i < text.size(); ++i )
+      put(text[i]);
+    put('\n');
+  }
+
+  void Header(long vars, long clauses) {
+    put(keyword()); put(' '); put(vars); put(' '); put(clauses); put('\n');
+  }
+
+  void Reserve() {
+    flush();
+    headerAt_ = std::ftell(out_);
+    if ( -1 == headerAt_ ) {
+      std::cerr << "DimacsWriter::Reserve(): output is not seekable" << std::endl;
+      throw(BAD);
+    }
+    std::string pad(reserved() - 2, ' ');
+    put('c'); put(pad.c_str()); put('\n');
+  }
+
+  template <typename Iter>
+  void Clause(Iter b, Iter e, bool isXor = false) {
+    if ( binary_ ) {
+      mapped_.clear();
+      for ( ; b != e; ++b ) {
+        long lit = static_cast<long>(*b);
+        mapped_.push_back(lit < 0 ? 2UL * static_cast<unsigned long>(-lit) + 1
+                                  : 2UL * static_cast<unsigned long>(lit));
+      } // for
+      std::sort(mapped_.begin(), mapped_.end());
+      if ( isXor )
+        putVarint(0);
+      unsigned long prev = 0;
+      for ( std::size_t i = 0; i < mapped_.size(); ++i ) {
+        putVarint(mapped_[i] - prev);
+        prev = mapped_[i];
+      } // for
+      putVarint(0);
+      ++clauses_;
+      return;
+    }
+    if ( isXor )
+      put('x');
+    for ( ; b != e; ++b ) {
+      put(static_cast<long>(*b));
+      put(' ');
+    } // for
+    put('0'); put('\n');
+    ++clauses_;
+  }
+
+  // iCNF, for cube-and-conquer: a 'p inccnf' header, the clauses, then one
+  //  'a' line of assumptions per cube
+  void IncrementalHeader() {
+    put("p inccnf\n");
+  }
+
+  template <typename Iter>
+  void Cube(Iter b, Iter e) {
+    put('a');
+    for ( ; b != e; ++b ) {
+      put(' ');
+      put(static_cast<long>(*b));
+    } // for
+    put(" 0\n");
+  }
+
+  // Only needed when Reserve() was used; patches in 'vars' and the number
+  //  of clauses written through this object.
+  void Finish(long vars = -1) {
+    flush();
+    if ( -1 == headerAt_ )
+      return;
+    std::stringstream hdr;
+    hdr << keyword() << " " << vars << " " << clauses_ << "\n";
+    std::string line = "c" + std::string(reserved() - hdr.str().size() - 2, ' ') + "\n" + hdr.str();
+    long end = std::ftell(out_);
+    if ( 0 != std::fseek(out_, headerAt_, SEEK_SET)
+         || line.size() != std::fwrite(line.data(), 1, line.size(), out_)
+         || 0 != std::fseek(out_, end, SEEK_SET) ) {
+      std::cerr << "DimacsWriter::Finish(): unable to patch header" << std::endl;
+      throw(BAD);
+    }
+    headerAt_ = -1;
+  }
 
 private:
-  LitType lits_;
+  enum { HeaderWidth = 42 }; // room for two 20-digit counts
+
+  const char* keyword() const {
+    return(binary_ ? "p bincnf" : "p cnf");
+  }
+
+  // Bytes held by Reserve(): the widest header and a bare "c\n" line
+  std::size_t reserved() const {
+    return(std::strlen(keyword()) + HeaderWidth + 1 + 2);
+  }
+
+  void putVarint(unsigned long value) {
+    if ( buf_.size() - pos_ < 12 )
+      flush();
+    do {
+      char low = static_cast<char>(value & 0x7F);
+      value >>= 7;
+      buf_[pos_++] = value ? static_cast<char>(low | 0x80) : low;
+    } while ( value );
+  }
+
+  void flush() {
+    if ( pos_ && pos_ != std::fwrite(&buf_[0], 1, pos_, out_) ) {
+      std::cerr << "DimacsWriter: write failed" << std::endl;
+      throw(BAD);
+    }
+    pos_ = 0;
+  }
+
+  void put(char c) {
+    if ( pos_ == buf_.size() )
+      flush();
+    buf_[pos_++] = c;
+  }
+
+  void put(const char* str) {
+    while ( *str )
+      put(*str++);
+  }
+
+  void put(long value) {
+    if ( buf_.size() - pos_ < 24 )
+      flush();
+    unsigned long u = static_cast<unsigned long>(value);
+    if ( value < 0 ) {
+      buf_[pos_++] = '-';
+      u = 0UL - u;
+    }
+    char digits[24];
+    int n = 0;
+    do {
+      digits[n++] = static_cast<char>('0' + u % 10);
+      u /= 10;
+    } while ( u );
+    while ( n )
+      buf_[pos_++] = digits[--n];
+  }
+
+  std::FILE* out_;
+  std::vector<char> buf_;
+  std::size_t pos_;
+  long headerAt_;
+  long clauses_;
+  bool binary_;
+  std::vector<unsigned long> mapped_;
 };
 
 namespace { // unnamed
-  typedef std::vector<Clause> Container;
-  Container outputCNF;
-  bool BAD = false;
+  ClauseDB outputCNF;
+  GateStyle gates;
+
+  // --compress and --format: every CNF iencode writes (standard output,
+  //  cube shards, the template's multiplier) is piped through the
+  //  compressor, if any, and written in DIMACS or the binary clause format
+  struct OutputStyle {
+    OutputStyle() : binary_(false)
+    { /* */ }
+
+    std::string compress_; // gzip, xz or zstd; empty for none
+    bool binary_;
+  };
+  OutputStyle output;
+
+  // While a worker thread builds rows of the array (see Encoding::threads_),
+  //  the gates it constructs write to that row's own ClauseDB, and count
+  //  its half adder cells, instead of the globals
+  __thread ClauseDB* rowCNF = 0;
+  __thread long halfAdderCells = 0;
+
+  ClauseDB& Sink() {
+    return(rowCNF ? *rowCNF : outputCNF);
+  }
+
+  // The same for --stats: a worker counts into its row's EncoderStats, and
+  //  'buildPart' is the component being built (a BitAdder row keeps the
+  //  cells strung in it to itself)
+  EncoderStats encoderStats;
+  __thread EncoderStats* rowStats = 0;
+  __thread int buildPart = EncoderStats::Other;
+
+  EncoderStats& Tally() {
+    return(rowStats ? *rowStats : encoderStats);
+  }
+
+  // One instance of component 'p', numbering 'vars' new variables
+  void Tally(EncoderStats::Part p, long vars) {
+    EncoderStats& stats = Tally();
+    if ( buildPart == EncoderStats::BitAdderRows && p != EncoderStats::BitAdderRows ) {
+      stats.vars_[buildPart] += vars;
+      return;
+    }
+    ++stats.count_[p];
+    stats.vars_[p] += vars;
+  }
+
+  // Counts everything kept while it lives under component 'p'
+  struct Component {
+    explicit Component(EncoderStats::Part p) : outer_(buildPart) {
+      if ( buildPart != EncoderStats::BitAdderRows )
+        buildPart = p;
+    }
+
+    ~Component() {
+      buildPart = outer_;
+    }
+
+  private:
+    int outer_;
+  };
+
+  // Streaming mode: rather than accumulating the whole CNF, the encoder
+  //  calls FlushCNF() after each row; kept clauses are handed to streamCNF
+  //  (or just counted when it is null) and then forgotten.
+  bool streaming = false;
+  DimacsWriter* streamCNF = 0;
+  long streamedClauses = 0;
 
   struct UseAbs {
     bool operator()(long a, long b) const {
@@ -55,116 +531,977 @@ namespace { // unnamed
       throw(BAD);
     }
     std::vector<long> toRtn;
-    for ( std::size_t idx = 0; idx < str.size(); ++idx ) {
-      std::string next;
-      next += str[idx];
-      std::stringstream convert(next);
-      long value;
-      convert >> value;
-      toRtn.push_back(value);
-    } // for
-    std::reverse(toRtn.begin(), toRtn.end());
+    toRtn.reserve(str.size());
+    for ( std::size_t idx = str.size(); idx-- > 0; )
+      toRtn.push_back(str[idx] - '0');
     return(toRtn);
   }
 
-  void KeepCNF(const Container& v) {
-    std::copy(v.begin(), v.end(), std::back_inserter(outputCNF));
+  // The clause just closed on 'cnf', for --stats
+  void Counted(const ClauseDB& cnf) {
+    EncoderStats& stats = Tally();
+    std::size_t c = cnf.Size() - 1;
+    ++stats.clauses_[buildPart];
+    stats.literals_[buildPart] += static_cast<long>(cnf.End(c) - cnf.Begin(c));
   }
 
-  void KeepCNF(const Clause& c) {
-    outputCNF.push_back(c);
+  void KeepCNF(long unitResolution) {
+    ClauseDB& cnf = Sink();
+    cnf.Push(unitResolution);
+    cnf.Close();
+    Counted(cnf);
   }
 
-  void KeepCNF(long unitResolution) {
-    Clause::LitType lt;
-    lt.insert(unitResolution);
-    Clause tmp(lt);
-    outputCNF.push_back(tmp);
-  }
-
-  void OutputCNF(std::ostream& os, long halfSize) {
-    std::set<long> toSort;
-    Container::const_iterator i = outputCNF.begin();
-    while ( i != outputCNF.end() ) {
-      Clause::LitType tmp = *i++;
-      std::copy(tmp.begin(), tmp.end(),
-                std::inserter(toSort, toSort.begin()));
-    } // while
-    toSort.erase(toSort.begin(), toSort.lower_bound(0));
-
-    os << "c half size = " << halfSize << std::endl;
-    os << "p cnf " << toSort.size() << " " << outputCNF.size() << std::endl;
-    i = outputCNF.begin();
-    while ( i != outputCNF.end() ) {
-      Clause::LitType lt = *i;
-      std::copy(lt.begin(), lt.end(),
-                std::ostream_iterator<long>(os, " "));
-      os << 0 << std::endl;
-      ++i;
-    } // while
+  void KeepCNF(long a, long b) {
+    ClauseDB& cnf = Sink();
+    cnf.Push(a); cnf.Push(b);
+    cnf.Close();
+    Counted(cnf);
+  }
+
+  void KeepCNF(long a, long b, long c) {
+    ClauseDB& cnf = Sink();
+    cnf.Push(a); cnf.Push(b); cnf.Push(c);
+    cnf.Close();
+    Counted(cnf);
+  }
+
+  void KeepCNF(long a, long b, long c, long d) {
+    ClauseDB& cnf = Sink();
+    cnf.Push(a); cnf.Push(b); cnf.Push(c); cnf.Push(d);
+    cnf.Close();
+    Counted(cnf);
+  }
+
+  // Closes a clause pushed straight onto outputCNF
+  void CloseCNF() {
+    outputCNF.Close();
+    Counted(outputCNF);
+  }
+
+  // sum <-> a ^ b (^ c) as the XOR constraint -sum ^ a ^ b (^ c) = true;
+  //  c of 0 is an absent input
+  void KeepXor(long sum, long a, long b, long c = 0) {
+    ClauseDB& cnf = Sink();
+    cnf.Push(-sum); cnf.Push(a); cnf.Push(b);
+    if ( 0 != c )
+      cnf.Push(c);
+    cnf.CloseXor();
+    Counted(cnf);
+  }
+
+  void FlushCNF() {
+    if ( !streaming )
+      return;
+    if ( streamCNF ) {
+      for ( std::size_t c = 0; c < outputCNF.Size(); ++c )
+        streamCNF->Clause(outputCNF.Begin(c), outputCNF.End(c), outputCNF.IsXor(c));
+    }
+    streamedClauses += static_cast<long>(outputCNF.Size());
+    outputCNF.Clear();
+  }
+
+  void StreamCNF(DimacsWriter* dw) {
+    outputCNF.Clear();
+    streaming = true;
+    streamCNF = dw;
+    streamedClauses = 0;
+  }
+
+  // Plaisted-Greenbaum reduction over a tagged outputCNF.  Gate outputs
+  //  are numbered after their inputs, so walking variables from the top
+  //  down sees every use of a gate before its definition.  A gate used
+  //  positively keeps its (-g ...) clauses, one used negatively keeps its
+  //  (g ...) clauses; literals of kept clauses become uses in turn.
+  //  Returns the number of clauses removed.
+  long PolarityReduce(long numVars) {
+    enum { Pos = 1, Neg = 2 };
+    std::vector<char> need(numVars + 1, 0);
+    std::vector<std::size_t> first(numVars + 2, 0), byVar;
+    for ( std::size_t c = 0; c < outputCNF.Size(); ++c ) {
+      long d = outputCNF.Defines(c);
+      if ( d )
+        ++first[d];
+      else {
+        for ( const ClauseDB::LitType* l = outputCNF.Begin(c); l != outputCNF.End(c); ++l )
+          need[std::abs(*l)] |= (*l > 0 ? Pos : Neg);
+      }
+    } // for
+    for ( long v = 1; v <= numVars + 1; ++v )
+      first[v] += first[v-1];
+    byVar.resize(first[numVars + 1]);
+    for ( std::size_t c = outputCNF.Size(); c-- > 0; ) {
+      long d = outputCNF.Defines(c);
+      if ( d )
+        byVar[--first[d]] = c;
+    } // for
+
+    std::vector<bool> keep(outputCNF.Size(), true);
+    long removed = 0;
+    for ( long v = numVars; v > 0; --v ) {
+      for ( std::size_t i = first[v]; i < first[v+1]; ++i ) {
+        std::size_t c = byVar[i];
+        bool isXor = outputCNF.IsXor(c); // both directions at once
+        const ClauseDB::LitType* l = outputCNF.Begin(c);
+        while ( std::abs(*l) != v )
+          ++l;
+        if ( !(need[v] & (isXor ? Pos | Neg : (*l < 0 ? Pos : Neg))) ) {
+          keep[c] = false;
+          ++removed;
+          continue;
+        }
+        for ( l = outputCNF.Begin(c); l != outputCNF.End(c); ++l ) {
+          if ( std::abs(*l) != v )
+            need[std::abs(*l)] |= (isXor ? Pos | Neg : (*l > 0 ? Pos : Neg));
+        } // for
+      } // for
+    } // for
+    outputCNF.Compact(keep);
+    return(removed);
+  }
+
+  // One look at clause c under the partial assignment 'value': a satisfied
+  //  clause is marked done, a clause with a single open literal assigns it
+  //  (queued on 'trail').  Returns false on a conflict.
+  bool UnitVisit(std::size_t c, std::vector<signed char>& value,
+                 std::vector<long>& trail, std::vector<bool>& done) {
+    if ( done[c] )
+      return(true);
+    bool isXor = outputCNF.IsXor(c), sat = false, parity = false;
+    long open = 0, unassigned = 0;
+    for ( const ClauseDB::LitType* l = outputCNF.Begin(c); l != outputCNF.End(c); ++l ) {
+      signed char v = value[std::abs(*l)];
+      if ( 0 == v ) {
+        open = *l;
+        ++unassigned;
+      } else if ( isXor )
+        parity ^= ((v > 0) == (*l > 0));
+      else if ( (v > 0) == (*l > 0) )
+        sat = true;
+    } // for
+    if ( sat || (isXor && 0 == unassigned) ) {
+      done[c] = true;
+      return(sat || parity);
+    } else if ( 0 == unassigned )
+      return(false);
+    else if ( 1 == unassigned ) {
+      done[c] = true;
+      bool truth = !isXor || !parity; // what the open literal must be
+      value[std::abs(open)] = ((open > 0) == truth) ? 1 : -1;
+      trail.push_back(std::abs(open));
+    }
+    return(true);
+  }
+
+  // Unit propagation over outputCNF (clauses and XOR constraints) to a
+  //  fixpoint.  Satisfied clauses are dropped, assigned variables removed
+  //  from the rest, and the surviving variables renumbered densely with the
+  //  factor bits (1..keepVars) first and in order, even where no clause
+  //  mentions them.  'varMap' gets one token per factor bit: its new number,
+  //  or T/F when forced.  A conflict leaves just the clauses 1 and -1.
+  //  Returns the new variable count; 'forced' gets the number assigned.
+  long Simplify(long numVars, long keepVars, std::vector<std::string>& varMap,
+                long& forced) {
+    std::vector<std::size_t> first(numVars + 2, 0), byVar;
+    for ( std::size_t c = 0; c < outputCNF.Size(); ++c ) {
+      for ( const ClauseDB::LitType* l = outputCNF.Begin(c); l != outputCNF.End(c); ++l )
+        ++first[std::abs(*l)];
+    } // for
+    for ( long v = 1; v <= numVars + 1; ++v )
+      first[v] += first[v-1];
+    byVar.resize(first[numVars + 1]);
+    for ( std::size_t c = outputCNF.Size(); c-- > 0; ) {
+      for ( const ClauseDB::LitType* l = outputCNF.Begin(c); l != outputCNF.End(c); ++l )
+        byVar[--first[std::abs(*l)]] = c;
+    } // for
+
+    std::vector<signed char> value(numVars + 1, 0);
+    std::vector<bool> done(outputCNF.Size(), false);
+    std::vector<long> trail;
+    bool ok = true;
+    for ( std::size_t c = 0; c < outputCNF.Size() && ok; ++c )
+      ok = UnitVisit(c, value, trail, done);
+    for ( std::size_t q = 0; q < trail.size() && ok; ++q ) {
+      for ( std::size_t i = first[trail[q]]; i < first[trail[q]+1] && ok; ++i )
+        ok = UnitVisit(byVar[i], value, trail, done);
+    } // for
+    forced = static_cast<long>(trail.size());
+
+    ClauseDB out;
+    std::vector<long> newVar(numVars + 1, 0);
+    long next = 0;
+    varMap.clear();
+    if ( !ok ) {
+      out.Push(1); out.Close();
+      out.Push(-1); out.Close();
+      outputCNF.Swap(out);
+      varMap.push_back("1");
+      varMap.resize(keepVars, "F");
+      return(1);
+    }
+
+    for ( long v = 1; v <= keepVars; ++v ) {
+      std::stringstream token;
+      if ( value[v] )
+        token << (value[v] > 0 ? "T" : "F");
+      else
+        token << (newVar[v] = ++next);
+      varMap.push_back(token.str());
+    } // for
+    for ( std::size_t c = 0; c < outputCNF.Size(); ++c ) {
+      if ( done[c] )
+        continue;
+      bool flip = false; // XOR: an assigned true literal flips the parity
+      std::vector<long> lits;
+      for ( const ClauseDB::LitType* l = outputCNF.Begin(c); l != outputCNF.End(c); ++l ) {
+        long var = std::abs(*l);
+        if ( value[var] )
+          flip ^= ((value[var] > 0) == (*l > 0));
+        else {
+          if ( 0 == newVar[var] )
+            newVar[var] = ++next;
+          lits.push_back((*l > 0) ? newVar[var] : -newVar[var]);
+        }
+      } // for
+      if ( flip && outputCNF.IsXor(c) )
+        lits[0] = -lits[0];
+      for ( std::size_t i = 0; i < lits.size(); ++i )
+        out.Push(lits[i]);
+      if ( outputCNF.IsXor(c) )
+        out.CloseXor();
+      else
+        out.Close();
+    } // for
+    outputCNF.Swap(out);
+    return(next);
+  }
+
+  // Symmetric instances keep the original 'half size' comment; others
+  //  state both factor widths.  extract-sat understands either.
+  void HeaderComments(DimacsWriter& dw, long widthA, long widthB) {
+    std::stringstream comment;
+    if ( widthA == widthB )
+      comment << "half size = " << widthA;
+    else
+      comment << "factor widths = " << widthA << " " << widthB;
+    dw.Comment(comment.str());
+  }
+
+  // The 'c meta' block (see Metadata.h).  'varMap' is as from Simplify(),
+  //  or empty while the factor bits are still variables 1..widthA+widthB;
+  //  'decimal' is N, or empty in template mode
+  std::vector<std::string> MetadataNotes(long widthA, long widthB, long productWidth,
+                                         const std::string& variant, const std::string& decimal,
+                                         const std::vector<std::string>& varMap) {
+    Metadata meta;
+    meta.widthA_ = widthA;
+    meta.widthB_ = widthB;
+    meta.productWidth_ = productWidth;
+    meta.variant_ = variant;
+    if ( !decimal.empty() )
+      meta.hash_ = Metadata::Hash(decimal);
+    if ( varMap.empty() ) {
+      meta.Factor(true, 1, widthA);
+      meta.Factor(false, widthA + 1, widthB);
+    } else {
+      meta.Factor(true, std::vector<std::string>(varMap.begin(), varMap.begin() + widthA));
+      meta.Factor(false, std::vector<std::string>(varMap.begin() + widthA, varMap.end()));
+    }
+    return(meta.Lines());
+  }
+
+  // The suffix a compressed file gets, after .cnf
+  std::string CompressedSuffix() {
+    if ( output.compress_ == "gzip" )
+      return(".gz");
+    else if ( output.compress_ == "xz" )
+      return(".xz");
+    else if ( output.compress_ == "zstd" )
+      return(".zst");
+    return("");
+  }
+
+  // Opens 'name' for writing, or standard output when it is empty; with
+  //  --compress the data goes through the compressor instead
+  std::FILE* OpenOutput(const std::string& name) {
+    if ( output.compress_.empty() )
+      return(name.empty() ? stdout : std::fopen(name.c_str(), "w"));
+    std::string cmd = output.compress_ + " -c";
+    if ( output.compress_ == "zstd" )
+      cmd += " -q";
+    if ( !name.empty() ) {
+      cmd += " > '";
+      for ( std::size_t i = 0; i < name.size(); ++i )
+        cmd += (name[i] == '\'' ? std::string("'\\''") : std::string(1, name[i]));
+      cmd += "'";
+    }
+    std::fflush(stdout);
+    return(popen(cmd.c_str(), "w"));
+  }
+
+  void CloseOutput(std::FILE* out, const std::string& name) {
+    if ( output.compress_.empty() ) {
+      if ( out != stdout && 0 != std::fclose(out) ) {
+        std::cerr << "Unable to write " << name << std::endl;
+        throw(BAD);
+      }
+    } else if ( 0 != pclose(out) ) {
+      std::cerr << output.compress_ << " failed writing "
+                << (name.empty() ? std::string("standard output") : name) << std::endl;
+      throw(BAD);
+    }
+  }
+
+  // 'units' are extra unit clauses written after outputCNF (a cube's shard)
+  void OutputCNF(DimacsWriter& dw, long widthA, long widthB, long numVars,
+                 const std::vector<std::string>& notes,
+                 const std::vector<long>& units = std::vector<long>()) {
+    HeaderComments(dw, widthA, widthB);
+    for ( std::size_t i = 0; i < notes.size(); ++i )
+      dw.Comment(notes[i]);
+    dw.Header(numVars, static_cast<long>(outputCNF.Size() + units.size()));
+    for ( std::size_t c = 0; c < outputCNF.Size(); ++c )
+      dw.Clause(outputCNF.Begin(c), outputCNF.End(c), outputCNF.IsXor(c));
+    for ( std::size_t u = 0; u < units.size(); ++u )
+      dw.Clause(&units[u], &units[u] + 1);
+    dw.Finish();
+  }
+
+  typedef std::vector<std::vector<long> > Cubes;
+
+  // Cube-and-conquer split: the top 'k' bits that a factor no larger than
+  //  sqrt(N) can have, from the narrower factor (A when widths are equal).
+  //  Whatever the bounds, the 2^k cubes over them cover every assignment.
+  std::vector<long> CubeVariables(long k, long widthA, long widthB, long n) {
+    long base = (widthA <= widthB) ? 1 : widthA + 1;
+    long top = std::min((n + 1) / 2, std::min(widthA, widthB)) - 1;
+    if ( k > top ) {
+      std::cerr << "--cubes: at most " << std::max(top, 0L)
+                << " split bits for this input" << std::endl;
+      throw(BAD);
+    }
+    std::vector<long> split;
+    for ( long bit = top; bit > top - k; --bit )
+      split.push_back(base + bit);
+    return(split);
+  }
+
+  // Cube 'index' sets split[j] to bit k-1-j of the index.  With a variable
+  //  map from Simplify(), literals of forced variables are dropped, or make
+  //  the cube contradictory (1 -1) when they disagree.
+  Cubes MakeCubes(const std::vector<long>& split,
+                  const std::vector<std::string>& varMap) {
+    std::size_t k = split.size();
+    Cubes cubes(1UL << k);
+    for ( std::size_t index = 0; index < cubes.size(); ++index ) {
+      bool contradiction = false;
+      for ( std::size_t j = 0; j < k; ++j ) {
+        bool value = ((index >> (k - 1 - j)) & 1) != 0;
+        long var = split[j];
+        if ( !varMap.empty() ) {
+          const std::string& token = varMap[var - 1];
+          if ( token == "T" || token == "F" ) {
+            contradiction |= (value != (token == "T"));
+            continue;
+          }
+          std::stringstream convert(token);
+          convert >> var;
+        }
+        cubes[index].push_back(value ? var : -var);
+      } // for
+      if ( contradiction ) {
+        cubes[index].assign(1, 1);
+        cubes[index].push_back(-1);
+      }
+    } // for
+    return(cubes);
+  }
+
+  // One standalone CNF per cube (prefix.<i>.cnf), plus prefix.manifest: the
+  //  same header comments, so extract-sat accepts it in place of any shard,
+  //  and a 'c cube' line per shard with its assumptions.  Each shard says
+  //  which it is ('c shard i of K = ...'), as UNSAT there rules out only
+  //  its own cube.
+  void OutputShards(const std::string& prefix, long widthA, long widthB,
+                    long numVars, const std::vector<std::string>& notes,
+                    const Cubes& cubes) {
+    std::string name = prefix + ".manifest";
+    std::FILE* manifest = std::fopen(name.c_str(), "w");
+    if ( !manifest ) {
+      std::cerr << "Unable to create " << name << std::endl;
+      throw(BAD);
+    }
+    DimacsWriter mw(manifest);
+    HeaderComments(mw, widthA, widthB);
+    for ( std::size_t i = 0; i < notes.size(); ++i )
+      mw.Comment(notes[i]);
+    for ( std::size_t i = 0; i < cubes.size(); ++i ) {
+      std::stringstream file, line, shard, lits;
+      file << prefix << "." << i << ".cnf" << CompressedSuffix();
+      for ( std::size_t j = 0; j < cubes[i].size(); ++j )
+        lits << " " << cubes[i][j];
+      line << "cube " << i << " " << file.str() << lits.str() << " 0";
+      mw.Comment(line.str());
+      shard << "shard " << i << " of " << cubes.size() << " =" << lits.str() << " 0";
+      std::vector<std::string> shardNotes(notes);
+      shardNotes.push_back(shard.str());
+
+      std::FILE* out = OpenOutput(file.str());
+      if ( !out ) {
+        std::cerr << "Unable to create " << file.str() << std::endl;
+        throw(BAD);
+      }
+      {
+        DimacsWriter dw(out);
+        dw.Binary(output.binary_);
+        OutputCNF(dw, widthA, widthB, numVars, shardNotes, cubes[i]);
+      }
+      CloseOutput(out, file.str());
+    } // for
+    mw.Finish();
+    std::fclose(manifest);
+  }
+
+  // Template mode with files: the number-independent CNF as prefix.cnf,
+  //  and each number's product bits as unit clauses in prefix.<i>.units
+  void OutputTemplate(const std::string& prefix, long widthA, long widthB,
+                      long numVars, const std::vector<std::string>& notes,
+                      const std::vector<std::string>& numbers, const Cubes& pins) {
+    std::string name = prefix + ".cnf" + CompressedSuffix();
+    std::FILE* out = OpenOutput(name);
+    if ( !out ) {
+      std::cerr << "Unable to create " << name << std::endl;
+      throw(BAD);
+    }
+    {
+      DimacsWriter dw(out);
+      dw.Binary(output.binary_);
+      OutputCNF(dw, widthA, widthB, numVars, notes);
+    }
+    CloseOutput(out, name);
+
+    for ( std::size_t i = 0; i < pins.size(); ++i ) {
+      std::stringstream file;
+      file << prefix << "." << i << ".units";
+      out = std::fopen(file.str().c_str(), "w");
+      if ( !out ) {
+        std::cerr << "Unable to create " << file.str() << std::endl;
+        throw(BAD);
+      }
+      DimacsWriter dw(out);
+      dw.Comment("number = " + numbers[i]);
+      for ( std::size_t u = 0; u < pins[i].size(); ++u )
+        dw.Clause(&pins[i][u], &pins[i][u] + 1);
+      dw.Finish();
+      std::fclose(out);
+    } // for
+  }
+
+  // iCNF: the CNF once, then the cubes as assumptions
+  void OutputCubes(DimacsWriter& dw, long widthA, long widthB,
+                   const std::vector<std::string>& notes, const Cubes& cubes) {
+    HeaderComments(dw, widthA, widthB);
+    for ( std::size_t i = 0; i < notes.size(); ++i )
+      dw.Comment(notes[i]);
+    dw.IncrementalHeader();
+    for ( std::size_t c = 0; c < outputCNF.Size(); ++c )
+      dw.Clause(outputCNF.Begin(c), outputCNF.End(c), outputCNF.IsXor(c));
+    for ( std::size_t i = 0; i < cubes.size(); ++i )
+      dw.Cube(cubes[i].begin(), cubes[i].end());
+    dw.Finish();
   }
 } // unnamed
 
 
+/*
+  Aig: optional intermediate form of the circuit (--aig).  While one is
+   installed as 'circuit', the gate constructors below record definitions
+   here instead of writing clauses.  Constraints (unit clauses, comparator
+   and no-overflow clauses) still go to outputCNF, over encoder variables.
+  Nodes are And-Inverter Graph ANDs plus XOR and majority nodes: adders are
+   most of a multiplier, and blasting them into ANDs would cost clauses.
+   Edges are literals 2*node+complement; node 0 is constant false.
+  Every definition is constant-folded and structurally hashed on the way
+   in, so duplicate gates share a node and constant inputs simplify gates
+   away.  Emit() then replaces outputCNF by clauses for the nodes that some
+   constraint reaches, numbered densely after the primary inputs.
+  Each node remembers the --stats component that created it, and its
+   clauses are counted there when emitted; a node shared by hashing is
+   charged to the first.
+*/
+struct Aig {
+  typedef long Lit;
+  enum Kind { Const, Input, And, Xor, Xor3, Maj };
+
+  Aig() : table_(1024, 0), recorded_(0), emitted_(0) {
+    newNode(Const, 0, 0, 0, 0);
+  }
+
+  void SetConstant(long var, bool value) {
+    bind(var, value ? 1 : 0);
+  }
+
+  void DefineAnd(long var, long a, long b) {
+    bind(var, mkAnd(lit(a), lit(b)));
+  }
+
+  // c of 0 means a 2-input XOR
+  void DefineXor(long var, long a, long b, long c = 0) {
+    if ( 0 == c )
+      bind(var, mkXor(lit(a), lit(b)));
+    else
+      bind(var, mkXor3(lit(a), lit(b), lit(c)));
+  }
+
+  void DefineMaj(long var, long a, long b, long c) {
+    bind(var, mkMaj(lit(a), lit(b), lit(c)));
+  }
+
+  long Recorded() const {
+    return(recorded_);
+  }
+
+  long Gates() const {
+    long gates = 0;
+    for ( std::size_t n = 0; n < kind_.size(); ++n )
+      gates += (kind_[n] != Const && kind_[n] != Input);
+    return(gates);
+  }
+
+  long Emitted() const {
+    return(emitted_);
+  }
+
+  // Variables 1..keepVars (the factor bits) keep their numbers.  Encoder
+  //  variables in 'visible' (template product bits) are kept as well, and
+  //  rewritten to their new literals.  Returns the number of variables in
+  //  the new outputCNF.
+  long Emit(long keepVars, std::vector<long>* visible = 0) {
+    std::vector<Lit> roots, shown;
+    for ( std::size_t c = 0; c < outputCNF.Size(); ++c ) {
+      for ( const ClauseDB::LitType* l = outputCNF.Begin(c); l != outputCNF.End(c); ++l )
+        roots.push_back(lit(*l));
+    } // for
+    for ( std::size_t i = 0; visible && i < visible->size(); ++i )
+      shown.push_back(lit((*visible)[i]));
+    std::size_t nodes = kind_.size();
+    std::vector<char> used(nodes, 0);
+    for ( std::size_t r = 0; r < roots.size(); ++r )
+      used[roots[r] >> 1] = 1;
+    for ( std::size_t i = 0; i < shown.size(); ++i )
+      used[shown[i] >> 1] = 1;
+    for ( std::size_t n = nodes; n-- > 1; ) { // fanins precede their nodes
+      if ( !used[n] )
+        continue;
+      for ( int f = 0; f < 3; ++f )
+        used[fanin_[3*n+f] >> 1] = 1;
+    } // for
+
+    std::vector<long> newVar(nodes, 0);
+    long next = keepVars;
+    for ( std::size_t n = 1; n < nodes; ++n ) {
+      if ( kind_[n] == Input && inputVar_[n] <= keepVars )
+        newVar[n] = inputVar_[n];
+      else if ( used[n] )
+        newVar[n] = ++next;
+    } // for
+
+    ClauseDB out;
+    out.Tagging(gates.polarity_);
+    out.Swap(outputCNF); // gate clauses are written through KeepCNF()
+    emitted_ = 0;
+    for ( std::size_t n = 1; n < nodes; ++n ) {
+      if ( !used[n] || kind_[n] == Input )
+        continue;
+      ++emitted_;
+      long o = newVar[n];
+      long a = dimacs(fanin_[3*n], newVar), b = dimacs(fanin_[3*n+1], newVar);
+      long c = dimacs(fanin_[3*n+2], newVar);
+      Component scope(static_cast<EncoderStats::Part>(part_[n]));
+      outputCNF.Define(o);
+      switch ( kind_[n] ) {
+        case And:
+          KeepCNF(-o, a); KeepCNF(-o, b); KeepCNF(o, -a, -b);
+          break;
+        case Xor:
+          if ( gates.xor_ )
+            KeepXor(o, a, b);
+          else {
+            KeepCNF(-o, a, b); KeepCNF(-o, -a, -b);
+            KeepCNF(o, -a, b); KeepCNF(o, a, -b);
+          }
+          break;
+        case Xor3:
+          if ( gates.xor_ )
+            KeepXor(o, a, b, c);
+          else {
+            for ( int m = 0; m < 8; ++m ) {
+              bool odd = ((m & 1) != 0) ^ ((m & 2) != 0) ^ ((m & 4) != 0);
+              KeepCNF(odd ? o : -o, (m & 1) ? -a : a, (m & 2) ? -b : b, (m & 4) ? -c : c);
+            } // for
+          }
+          break;
+        case Maj:
+          KeepCNF(-o, a, b); KeepCNF(-o, a, c); KeepCNF(-o, b, c);
+          KeepCNF(o, -a, -b); KeepCNF(o, -a, -c); KeepCNF(o, -b, -c);
+          break;
+        default:
+          break;
+      } // switch
+    } // for
+    outputCNF.Define(0);
+
+    // constraints: constant-true literals satisfy a clause, false ones drop
+    std::size_t r = 0;
+    for ( std::size_t c = 0; c < out.Size(); ++c ) {
+      std::vector<long> clause;
+      bool sat = false;
+      for ( const ClauseDB::LitType* l = out.Begin(c); l != out.End(c); ++l, ++r ) {
+        if ( roots[r] == 1 )
+          sat = true;
+        else if ( roots[r] != 0 )
+          clause.push_back(dimacs(roots[r], newVar));
+      } // for
+      if ( sat )
+        continue;
+      else if ( clause.empty() ) { // unsatisfiable
+        KeepCNF(1);
+        KeepCNF(-1);
+        continue;
+      }
+      for ( std::size_t i = 0; i < clause.size(); ++i )
+        outputCNF.Push(clause[i]);
+      outputCNF.Close();
+    } // for
+
+    // a visible bit that folded to a constant gets a variable of its own
+    for ( std::size_t i = 0; i < shown.size(); ++i ) {
+      if ( shown[i] > 1 )
+        (*visible)[i] = dimacs(shown[i], newVar);
+      else {
+        (*visible)[i] = ++next;
+        KeepCNF(shown[i] ? next : -next);
+      }
+    } // for
+    return(std::max(next, keepVars));
+  }
+
+private:
+  enum { Unbound = -1 };
+
+  long dimacs(Lit x, const std::vector<long>& newVar) const {
+    long v = newVar[x >> 1];
+    return((x & 1) ? -v : v);
+  }
+
+  // Encoder literal to graph literal; an unbound variable is a free input
+  Lit lit(long v) {
+    long var = std::abs(v);
+    if ( var >= static_cast<long>(varLit_.size()) )
+      varLit_.resize(var + 1, Unbound);
+    if ( varLit_[var] == Unbound ) {
+      varLit_[var] = 2 * newNode(Input, 0, 0, 0, var);
+    }
+    return(v < 0 ? varLit_[var] ^ 1 : varLit_[var]);
+  }
+
+  void bind(long var, Lit x) {
+    if ( var >= static_cast<long>(varLit_.size()) )
+      varLit_.resize(var + 1, Unbound);
+    varLit_[var] = x;
+    ++recorded_;
+  }
+
+  Lit mkAnd(Lit a, Lit b) {
+    if ( a > b )
+      std::swap(a, b);
+    if ( a == 0 || a == (b ^ 1) )
+      return(0);
+    else if ( a == 1 )
+      return(b);
+    else if ( a == b )
+      return(a);
+    return(lookup(And, a, b, 0));
+  }
+
+  Lit mkXor(Lit a, Lit b) {
+    Lit neg = (a ^ b) & 1;
+    a &= ~1L; b &= ~1L;
+    if ( a > b )
+      std::swap(a, b);
+    if ( a == b )
+      return(neg);
+    else if ( a == 0 )
+      return(b ^ neg);
+    return(lookup(Xor, a, b, 0) ^ neg);
+  }
+
+  Lit mkXor3(Lit a, Lit b, Lit c) {
+    Lit neg = (a ^ b ^ c) & 1;
+    Lit f[3] = { a & ~1L, b & ~1L, c & ~1L };
+    std::sort(f, f + 3);
+    if ( f[0] == 0 )
+      return(mkXor(f[1], f[2]) ^ neg);
+    else if ( f[0] == f[1] )
+      return(f[2] ^ neg);
+    else if ( f[1] == f[2] )
+      return(f[0] ^ neg);
+    return(lookup(Xor3, f[0], f[1], f[2]) ^ neg);
+  }
+
+  Lit mkMaj(Lit a, Lit b, Lit c) {
+    Lit f[3] = { a, b, c };
+    std::sort(f, f + 3);
+    if ( f[0] == 0 )
+      return(mkAnd(f[1], f[2]));
+    else if ( f[0] == 1 )
+      return(mkAnd(f[1] ^ 1, f[2] ^ 1) ^ 1);
+    else if ( f[0] == f[1] || f[0] == (f[2] ^ 1) )
+      return(f[1]);
+    else if ( f[1] == f[2] || f[0] == (f[1] ^ 1) )
+      return(f[2]);
+    else if ( f[1] == (f[2] ^ 1) )
+      return(f[0]);
+    // maj(!a,!b,!c) = !maj(a,b,c): keep at most one complemented fanin
+    Lit neg = 0;
+    if ( (f[0] & 1) + (f[1] & 1) + (f[2] & 1) >= 2 ) {
+      for ( int i = 0; i < 3; ++i )
+        f[i] ^= 1;
+      neg = 1;
+      std::sort(f, f + 3);
+    }
+    return(lookup(Maj, f[0], f[1], f[2]) ^ neg);
+  }
+
+  std::size_t hash(long kind, Lit a, Lit b, Lit c) const {
+    unsigned long h = static_cast<unsigned long>(kind);
+    h = h * 0x9E3779B1UL + static_cast<unsigned long>(a);
+    h = h * 0x9E3779B1UL + static_cast<unsigned long>(b);
+    h = h * 0x9E3779B1UL + static_cast<unsigned long>(c);
+    return(static_cast<std::size_t>(h ^ (h >> 15)) & (table_.size() - 1));
+  }
+
+  // Structural hashing: open addressing over node indices (0 = empty slot)
+  Lit lookup(Kind kind, Lit a, Lit b, Lit c) {
+    std::size_t slot = hash(kind, a, b, c);
+    for ( ; table_[slot]; slot = (slot + 1) & (table_.size() - 1) ) {
+      long n = table_[slot];
+      if ( kind_[n] == kind && fanin_[3*n] == a && fanin_[3*n+1] == b && fanin_[3*n+2] == c )
+        return(2 * n);
+    } // for
+    long n = newNode(kind, a, b, c, 0);
+    table_[slot] = n;
+    if ( 2 * kind_.size() > table_.size() ) { // grow and rehash
+      std::vector<long> old;
+      old.swap(table_);
+      table_.assign(2 * old.size(), 0);
+      for ( std::size_t i = 0; i < old.size(); ++i ) {
+        if ( !old[i] )
+          continue;
+        long m = old[i];
+        std::size_t t = hash(kind_[m], fanin_[3*m], fanin_[3*m+1], fanin_[3*m+2]);
+        while ( table_[t] )
+          t = (t + 1) & (table_.size() - 1);
+        table_[t] = m;
+      } // for
+    }
+    return(2 * n);
+  }
+
+  long newNode(Kind kind, Lit a, Lit b, Lit c, long var) {
+    kind_.push_back(static_cast<char>(kind));
+    part_.push_back(static_cast<char>(buildPart));
+    fanin_.push_back(a); fanin_.push_back(b); fanin_.push_back(c);
+    inputVar_.push_back(var);
+    return(static_cast<long>(kind_.size()) - 1);
+  }
+
+  std::vector<char> kind_, part_;
+  std::vector<Lit> fanin_;
+  std::vector<long> inputVar_;
+  std::vector<Lit> varLit_;
+  std::vector<long> table_;
+  long recorded_, emitted_;
+};
+
+namespace { // unnamed
+  Aig* circuit = 0;
+} // unnamed
+
+
 struct NotGreaterEqualN {
   typedef std::vector<long> Values;
 
   // Implementation: !(inputs > outputs) or !(+multiplicand > +product)
+  //  The multiplicand may be narrower or wider than the product; missing
+  //  high bits on either side are taken as zero.
   NotGreaterEqualN(long start, long end,
                    const Values& outputs, long& nextValue) {
+    Component scope(EncoderStats::Comparators);
+    long firstValue = nextValue;
     Values inputs;
     for ( long x = start; x <= end; ++x )
       inputs.push_back(x);
 
-    if ( inputs.size() != outputs.size() || outputs.empty() ) {
+    if ( inputs.empty() || outputs.empty() ) {
       std::cerr << "Bad Args: NotGreaterEqualN Construction" << std::endl;
       throw(BAD);
     }
 
-    Clause::LitType lt;
+    // cache holds, for each higher bit, a literal that is true when that
+    //  bit differs between inputs and outputs
     Values cache;
-    long sz = static_cast<long>(inputs.size()) - 1;
+    long sz = static_cast<long>(std::max(inputs.size(), outputs.size())) - 1;
     for ( long idx = sz; idx >= 0; --idx ) {
-      lt.clear();
-      lt.insert(-inputs[idx]);
-      lt.insert(outputs[idx]);
-      std::copy(cache.begin(), cache.end(),
-                std::inserter(lt, lt.begin()));
-      KeepCNF(Clause(lt));
+      bool hasIn = idx < static_cast<long>(inputs.size());
+      bool hasOut = idx < static_cast<long>(outputs.size());
+      if ( !hasIn ) { // input bit is 0: differs exactly when output is 1
+        cache.push_back(outputs[idx]);
+        continue;
+      }
+
+      outputCNF.Push(-inputs[idx]);
+      if ( hasOut )
+        outputCNF.Push(outputs[idx]);
+      for ( Values::const_iterator c = cache.begin(); c != cache.end(); ++c )
+        outputCNF.Push(*c);
+      CloseCNF();
+      if ( !hasOut ) { // output bit is 0
+        cache.push_back(inputs[idx]);
+        continue;
+      }
       cache.push_back(-(++nextValue));
+      if ( circuit ) { // nextValue <-> inputs[idx] == outputs[idx]
+        circuit->DefineXor(nextValue, inputs[idx], -outputs[idx]);
+        FlushCNF();
+        continue;
+      }
 
-      lt.clear();
-      lt.insert(-nextValue);
-      lt.insert(-inputs[idx]);
-      lt.insert(outputs[idx]);
-      KeepCNF(Clause(lt));
+      outputCNF.Define(nextValue);
+      KeepCNF(-nextValue, -inputs[idx], outputs[idx]);
+      KeepCNF(-nextValue, inputs[idx], -outputs[idx]);
+      KeepCNF(nextValue, inputs[idx], outputs[idx]);
+      KeepCNF(nextValue, -inputs[idx], -outputs[idx]);
+      outputCNF.Define(0);
+      FlushCNF();
+    } // for
+
+    // Ensure we do not get 1*N=N solutions
+    for ( long i = start+1; i <= end; ++i )
+      outputCNF.Push(i);
+    outputCNF.Push(-start);
+    CloseCNF();
+    Tally(EncoderStats::Comparators, nextValue - firstValue);
+  }
+};
 
-      lt.clear();
-      lt.insert(-nextValue);
-      lt.insert(inputs[idx]);
-      lt.insert(-outputs[idx]);
-      KeepCNF(Clause(lt));
 
-      lt.clear();
-      lt.insert(nextValue);
-      lt.insert(inputs[idx]);
-      lt.insert(outputs[idx]);
-      KeepCNF(Clause(lt));
+/*
+  FactorOrder: the default replacement for the two NotGreaterEqualN's.
+   small <= large numerically, compared from the top bit down: e_i stands
+   for "equal above bit i" and is forced whenever that is so, and while it
+   holds no bit of small may exceed large's.  3 clauses and 1 variable per
+   bit.  The narrower factor is 'small'; missing high bits are zero.
+   Then neither factor may be 1, one clause each.  With a*b = N that also
+   keeps both below N, so all that is left out is the mirror solution.
+*/
+struct FactorOrder {
+  typedef std::vector<long> Values;
 
-      lt.clear();
-      lt.insert(nextValue);
-      lt.insert(-inputs[idx]);
-      lt.insert(-outputs[idx]);
-      KeepCNF(Clause(lt));
+  FactorOrder(const Values& small, const Values& large, long& nextValue) {
+    if ( small.empty() || large.empty() ) {
+      std::cerr << "Bad Args: FactorOrder Construction" << std::endl;
+      throw(BAD);
+    }
+    Component scope(EncoderStats::Comparators);
+    long firstValue = nextValue;
+
+    long equal = 0; // 0: the constant true above the top bit
+    for ( std::size_t idx = std::max(small.size(), large.size()); idx-- > 0; ) {
+      long s = idx < small.size() ? small[idx] : 0;
+      long l = idx < large.size() ? large[idx] : 0;
+      if ( s ) { // equal above: no s > l here
+        if ( equal )
+          outputCNF.Push(-equal);
+        outputCNF.Push(-s);
+        if ( l )
+          outputCNF.Push(l);
+        CloseCNF();
+      }
+      if ( 0 == idx )
+        break;
+      // equal above and s == l here (s -> l already holds): s or !l
+      long next = ++nextValue;
+      if ( s ) {
+        if ( equal )
+          outputCNF.Push(-equal);
+        outputCNF.Push(-s);
+        outputCNF.Push(next);
+        CloseCNF();
+      }
+      if ( equal )
+        outputCNF.Push(-equal);
+      if ( l )
+        outputCNF.Push(l);
+      outputCNF.Push(next);
+      CloseCNF();
+      equal = next;
+      FlushCNF();
     } // for
 
-    // Ensure we do not get 1*N=N solutions
-    lt.clear();
-    for ( long i = start+1; i <= end; ++i )
-      lt.insert(i);
-    lt.insert(-start);
-    KeepCNF(Clause(lt));
+    notOne(small);
+    notOne(large);
+    Tally(EncoderStats::Comparators, nextValue - firstValue);
+  }
+
+private:
+  static void notOne(const Values& x) {
+    for ( std::size_t idx = 1; idx < x.size(); ++idx )
+      outputCNF.Push(x[idx]);
+    outputCNF.Push(-x[0]);
+    CloseCNF();
+  }
+};
+
+
+struct HalfAdder {
+  HalfAdder(long y, long z) : y_(y), z_(z)
+  { /* */ }
+
+  void Equivalence(long sVar, long cVar) const {
+    ++halfAdderCells;
+    if ( circuit ) {
+      circuit->DefineXor(sVar, y_, z_);
+      circuit->DefineAnd(cVar, y_, z_);
+      return;
+    }
+
+    // S-out
+    Sink().Define(sVar);
+    if ( gates.xor_ )
+      KeepXor(sVar, y_, z_);
+    else {
+      KeepCNF(-sVar, y_, z_);
+      KeepCNF(-sVar, -y_, -z_);
+      KeepCNF(sVar, -y_, z_);
+      KeepCNF(sVar, y_, -z_);
+    }
+
+    // C-out
+    Sink().Define(cVar);
+    KeepCNF(-cVar, y_);
+    KeepCNF(-cVar, z_);
+    KeepCNF(cVar, -y_, -z_);
+    if ( gates.strong_ ) {
+      KeepCNF(-cVar, -sVar);
+      KeepCNF(cVar, sVar, -y_);
+      KeepCNF(cVar, sVar, -z_);
+    }
+    Sink().Define(0);
   }
+
+private:
+  long y_, z_;
 };
 
 
@@ -185,109 +1522,86 @@ struct FullAdder {
     ok_ = true;
   }
 
-  std::pair<Container, Container> Equivalence(long sVar, long cVar) {
+  void Equivalence(long sVar, long cVar) const {
     if ( !ok_ ) {
       std::cerr << "FullAdder::Equivalence(): uninitialized" << std::endl;
-      throw(BAD);
-    }
-
-    // Remember 'x_' represents the carry-input
-
-    std::pair<Container, Container> toRtn;
-    Container first, second;
-    Clause::LitType cont;
-
-    // S-out
-    if ( 0 != x_ )
-      cont.insert(x_);
-    cont.insert(-sVar); cont.insert(y_); cont.insert(z_);
-    Clause c1(cont); first.push_back(c1);
-
-    cont.clear();
-    if ( 0 != x_ )
-      cont.insert(x_);
-    cont.insert(-sVar); cont.insert(-y_); cont.insert(-z_);
-    Clause c2(cont); first.push_back(c2);
- 
-    if ( 0 != x_ ) {
-      cont.clear();
-      cont.insert(-sVar); cont.insert(y_); cont.insert(-z_);
-      cont.insert(-x_);
-      Clause c3(cont); first.push_back(c3);
-    }
-
-    if ( 0 != x_ ) {
-      cont.clear();
-      cont.insert(-sVar); cont.insert(-y_); cont.insert(z_);
-      cont.insert(-x_);
-      Clause c4(cont); first.push_back(c4);
+      throw(BAD);
     }
+    Tally(EncoderStats::FullAdders, 2);
+    Component scope(EncoderStats::FullAdders);
 
-    if ( 0 != x_ ) {
-      cont.clear();
-      cont.insert(sVar); cont.insert(y_), cont.insert(z_);
-      cont.insert(-x_);
-      Clause c5(cont); first.push_back(c5);
+    // Remember 'x_' represents the carry-input
+    if ( circuit && 0 == x_ ) {
+      circuit->DefineXor(sVar, y_, z_);
+      circuit->DefineAnd(cVar, y_, z_);
+      return;
+    } else if ( circuit ) {
+      circuit->DefineXor(sVar, x_, y_, z_);
+      circuit->DefineMaj(cVar, x_, y_, z_);
+      return;
+    } else if ( 0 == x_ && gates.halfAdders_ ) {
+      HalfAdder(y_, z_).Equivalence(sVar, cVar);
+      return;
     }
 
-    cont.clear();
-    if ( 0 != x_ )
-      cont.insert(x_);
-    cont.insert(sVar); cont.insert(-y_); cont.insert(z_);
-    Clause c6(cont); first.push_back(c6);
-
-    if ( 0 != x_ ) {
-      cont.clear();
-      cont.insert(sVar); cont.insert(-y_); cont.insert(-z_);
-      cont.insert(-x_);
-      Clause c7(cont); first.push_back(c7);
+    // S-out
+    Sink().Define(sVar);
+    if ( gates.xor_ )
+      KeepXor(sVar, y_, z_, x_);
+    else {
+      keep(x_, -sVar, y_, z_);
+      keep(x_, -sVar, -y_, -z_);
+      if ( 0 != x_ ) {
+        KeepCNF(-sVar, y_, -z_, -x_);
+        KeepCNF(-sVar, -y_, z_, -x_);
+        KeepCNF(sVar, y_, z_, -x_);
+      }
+      keep(x_, sVar, -y_, z_);
+      if ( 0 != x_ )
+        KeepCNF(sVar, -y_, -z_, -x_);
+      keep(x_, sVar, y_, -z_);
     }
 
-    cont.clear();
-    if ( 0 != x_ )
-      cont.insert(x_);
-    cont.insert(sVar); cont.insert(y_); cont.insert(-z_);
-    Clause c8(cont); first.push_back(c8);
-
-
     // C-out
-    cont.clear();
+    Sink().Define(cVar);
+    keep(x_, -cVar, y_);
+    keep(x_, -cVar, z_);
+    KeepCNF(-cVar, y_, z_);
     if ( 0 != x_ )
-      cont.insert(x_);
-    cont.insert(-cVar); cont.insert(y_);
-    Clause c9(cont); second.push_back(c9);
-
-    cont.clear();
+      KeepCNF(cVar, y_, -z_, -x_);
+    keep(x_, cVar, -y_, -z_);
     if ( 0 != x_ )
-      cont.insert(x_);
-    cont.insert(-cVar); cont.insert(z_);
-    Clause c10(cont); second.push_back(c10);
-
-    cont.clear();
-    cont.insert(-cVar); cont.insert(y_); cont.insert(z_);
-    Clause c11(cont); second.push_back(c11);
-
-    if ( 0 != x_ ) {
-      cont.clear();
-      cont.insert(cVar); cont.insert(y_); cont.insert(-z_);
-      cont.insert(-x_); 
-      Clause c12(cont); second.push_back(c12);
+      KeepCNF(cVar, -y_, -x_);
+
+    if ( gates.strong_ ) { // redundant: s&c -> x,y,z and !s&!c -> !x,!y,!z
+      if ( 0 != x_ ) {
+        KeepCNF(-cVar, -sVar, x_);
+        KeepCNF(-cVar, -sVar, y_);
+        KeepCNF(-cVar, -sVar, z_);
+        KeepCNF(cVar, sVar, -x_);
+      }
+      else
+        KeepCNF(-cVar, -sVar);
+      KeepCNF(cVar, sVar, -y_);
+      KeepCNF(cVar, sVar, -z_);
     }
+    Sink().Define(0);
+  }
 
-    cont.clear();
-    if ( 0 != x_ )
-      cont.insert(x_);
-    cont.insert(cVar); cont.insert(-y_); cont.insert(-z_);
-    Clause c13(cont); second.push_back(c13);
-
-    if ( 0 != x_ ) {
-      cont.clear();
-      cont.insert(cVar); cont.insert(-y_);
-      cont.insert(-x_);
-      Clause c14(cont); second.push_back(c14);
-    }
+private:
+  // a zero carry-in is dropped from the clause rather than stored
+  static void keep(long x, long a, long b) {
+    if ( 0 != x )
+      KeepCNF(x, a, b);
+    else
+      KeepCNF(a, b);
+  }
 
-    return(std::make_pair(first, second));
+  static void keep(long x, long a, long b, long c) {
+    if ( 0 != x )
+      KeepCNF(x, a, b, c);
+    else
+      KeepCNF(a, b, c);
   }
 
 private:
@@ -299,26 +1613,30 @@ private:
 struct BitAdder {
   typedef std::vector<long> IOType;
 
+  // An input of 0 stands for a constant zero bit; the cell taking it
+  //  becomes a half adder on the other two.
   BitAdder(const IOType& it, long lastVar, long inCarry = 0) 
                                             : nextVar_(lastVar) {
     if ( it.empty() || (it.size() % 2) ) {
       std::cerr << "BitAdder::Constructor --> BadArg" << std::endl;
       throw(BAD);
     }
+    Tally(EncoderStats::BitAdderRows, 0);
+    Component scope(EncoderStats::BitAdderRows);
 
     std::size_t sz = it.size();
     FullAdder toAdd(inCarry, it[0], it[1]);
-    typedef std::pair<Container, Container> PType;
     long Sout = ++nextVar_, Cout = ++nextVar_;
-    PType pType = toAdd.Equivalence(Sout, Cout);
-    KeepCNF(pType.first); KeepCNF(pType.second);
+    toAdd.Equivalence(Sout, Cout);
 
     outputs_.push_back(Sout); // sout's
     for ( std::size_t i = 2; i < sz; i += 2 ) {
-      toAdd = FullAdder(Cout, it[i], it[i+1]);
+      if ( 0 == it[i] || 0 == it[i+1] )
+        toAdd = FullAdder(0, Cout, it[i] ? it[i] : it[i+1]);
+      else
+        toAdd = FullAdder(Cout, it[i], it[i+1]);
       Sout = ++nextVar_; Cout = ++nextVar_;
-      pType = toAdd.Equivalence(Sout, Cout);
-      KeepCNF(pType.first); KeepCNF(pType.second);
+      toAdd.Equivalence(Sout, Cout);
       outputs_.push_back(Sout);
     } // for
     outputs_.push_back(Cout);
@@ -339,36 +1657,141 @@ private:
 };
 
 
+/*
+  Encoding: shape of the multiplier circuit that CreateMultiplier builds.
+   Factor widths of zero mean the width of N itself.
+*/
+struct Encoding {
+  enum Multiplier { Array, Wallace, Dadda, Karatsuba };
+  enum Bounds { Ordered, Legacy };
+
+  Encoding() : widthA_(0), widthB_(0), truncate_(false), mult_(Array),
+               threshold_(16), modular_(0), residues_(), bounds_(Ordered),
+               template_(false), threads_(1)
+  { /* */ }
+
+  long widthA_, widthB_;
+  bool truncate_;
+  Multiplier mult_;
+  long threshold_; // Karatsuba falls back to schoolbook at this many bits
+  long modular_; // low factor bits tied together through a*b = N mod 2^k
+  std::vector<long> residues_; // odd moduli m checked as a*b = N mod m
+  Bounds bounds_; // FactorOrder, or the original pair of NotGreaterEqualN
+  bool template_; // product bits are left for assumptions, not pinned to N
+  long threads_; // array rows built in parallel; the output is the same
+};
+
+
 struct CreateMultiplier {
-  explicit CreateMultiplier(std::vector<long> soln) : nextVar_(0) {
-    if ( soln.empty() ) {
+  // Product bits past soln.size() are set to zero, or never built at all
+  //  when the encoding is truncated.
+  explicit CreateMultiplier(std::vector<long> soln,
+                            const Encoding& enc = Encoding())
+                                 : nextVar_(0), trueVar_(0),
+                                   template_(enc.template_) {
+    if ( soln.empty() || enc.widthA_ < 0 || enc.widthB_ < 0 ) {
       std::cerr << "CreateMultiplier::Constructor: BadArg" << std::endl;
       throw(BAD);
+    } else if ( enc.truncate_ && enc.mult_ == Encoding::Karatsuba ) {
+      std::cerr << "CreateMultiplier::Constructor: the Karatsuba multiplier"
+                << " cannot be truncated" << std::endl;
+      throw(BAD);
     }
-       
+
     // Make multiplier inputs
     std::size_t multBits = soln.size();
-    std::vector<long> Ax(multBits), Bx(multBits);
-    for ( std::size_t idx = 0; idx < multBits; ++idx )
+    std::size_t bitsA = enc.widthA_ ? enc.widthA_ : multBits;
+    std::size_t bitsB = enc.widthB_ ? enc.widthB_ : multBits;
+    if ( bitsA + bitsB < multBits ) {
+      std::cerr << "CreateMultiplier::Constructor: factor widths "
+                << bitsA << "+" << bitsB << " cannot reach "
+                << multBits << " product bits" << std::endl;
+      throw(BAD);
+    }
+    std::vector<long> Ax(bitsA), Bx(bitsB);
+    for ( std::size_t idx = 0; idx < bitsA; ++idx )
       Ax[idx] = ++nextVar_;
-    for ( std::size_t idx = 0; idx < multBits; ++idx )
+    for ( std::size_t idx = 0; idx < bitsB; ++idx )
       Bx[idx] = ++nextVar_;
-    max_ = nextVar_;
+    widthA_ = static_cast<long>(bitsA);
+    widthB_ = static_cast<long>(bitsB);
+
+    std::vector<long> outputs;
+    if ( enc.mult_ == Encoding::Karatsuba ) {
+      Bits product = karatsuba(Ax, Bx, std::max(enc.threshold_, 1L));
+      pinProduct(product, soln, outputs);
+      FlushCNF();
+    }
+    else if ( enc.mult_ != Encoding::Array )
+      treeProduct(Ax, Bx, soln, outputs, enc);
+    else if ( enc.truncate_ )
+      truncatedProduct(Ax, Bx, soln, outputs);
+    else if ( enc.threads_ > 1 && bitsA > 1 && !circuit )
+      parallelArrayProduct(Ax, Bx, soln, outputs, enc.threads_);
+    else
+      arrayProduct(Ax, Bx, soln, outputs);
+
+    if ( enc.bounds_ == Encoding::Legacy ) {
+      NotGreaterEqualN m1gen(Ax[0], Ax[bitsA-1], outputs, nextVar_);
+      NotGreaterEqualN m2gen(Bx[0], Bx[bitsB-1], outputs, nextVar_);
+    } else if ( bitsA <= bitsB )
+      FactorOrder order(Ax, Bx, nextVar_);
+    else
+      FactorOrder order(Bx, Ax, nextVar_);
+    FlushCNF();
+
+    // Redundant constraints straight on the factor bits
+    if ( enc.modular_ ) {
+      lowBits(Ax, Bx, soln, enc.modular_);
+      lowBits(Bx, Ax, soln, enc.modular_);
+    }
+    for ( std::size_t m = 0; m < enc.residues_.size(); ++m )
+      residueCheck(Ax, Bx, soln, enc.residues_[m]);
+    outputs_.swap(outputs);
+  }
+
+  long GetTotalInputBits() const {
+    return(widthA_ + widthB_);
+  }
+
+  long GetWidthA() const {
+    return(widthA_);
+  }
+
+  long GetWidthB() const {
+    return(widthB_);
+  }
+
+  long GetTotalVars() const {
+    return(nextVar_);
+  }
+
+  // Product bits below N's width, least significant first
+  const std::vector<long>& GetProductBits() const {
+    return(outputs_);
+  }
+
+private:
+  typedef std::vector<long> Bits;
+
+  // Full array: every partial product a_i*b_j is built, rows are summed by
+  //  BitAdders, and the product bits above N's width are pinned to zero.
+  void arrayProduct(const Bits& Ax, const Bits& Bx,
+                    const std::vector<long>& soln, Bits& outputs) {
+    std::size_t multBits = soln.size(), bitsA = Ax.size(), bitsB = Bx.size();
 
     // 'first' represents the fact that the input to the first bit adder
     //  comes from a set of AND'ed results, while any other bit adder
     //  receives half of its inputs from the preceding bit adder.
     long nextSoln = 0;
     bool first = true;
-    std::vector<long> outputs;
     BitAdder::IOType inputs;
-    for ( std::size_t idx = 0; idx < multBits; ++idx ) {
+    for ( std::size_t idx = 0; idx < bitsA; ++idx ) {
       long marker = nextVar_ + 1;
-      for ( std::size_t inner = 0; inner < multBits; ++inner ) {
+      for ( std::size_t inner = 0; inner < bitsB; ++inner ) {
         makeAndEq(Ax[idx], Bx[inner]);
         if ( !idx && !inner ) {
-          outputs.push_back(nextVar_);
-          setValue(nextVar_, soln[nextSoln++]);
+          pinOutput(nextVar_, soln[nextSoln++], outputs);
         }
       } // for
 
@@ -377,10 +1800,10 @@ struct CreateMultiplier {
       for ( long x = marker; x <= nextVar_; ++x )
         inputs.push_back(x);
 
-      if ( !idx ) {
-        inputs.push_back(++nextVar_);
-        setValue(nextVar_, 0);
-      }
+      if ( !idx && gates.halfAdders_ )
+        inputs.push_back(0);
+      else if ( !idx )
+        inputs.push_back(constantVar(0));
       else
         first = false;
 
@@ -398,55 +1821,578 @@ struct CreateMultiplier {
         BitAdder ba(inputs, nextVar_);
         nextVar_ = ba.NextVar();
         BitAdder::IOType out = ba.Output();
-        setValue(out[0], soln[nextSoln++]);
-        outputs.push_back(out[0]);
+        if ( nextSoln < static_cast<long>(multBits) )
+          pinOutput(out[0], soln[nextSoln++], outputs);
+        else
+          setValue(out[0], 0);
         inputs.clear();
         BitAdder::IOType::iterator iter = ++out.begin();
         std::copy(iter, out.end(), std::back_inserter(inputs));
       }
+      FlushCNF();
     } // for
 
-    // Declare values of remaining bits of soln
-    //   --> comes from output of last BitAdder
+    pinRemaining(inputs, soln, nextSoln, outputs);
+  }
+
+  // Declare values of remaining bits of soln
+  //   --> comes from output of last BitAdder
+  void pinRemaining(BitAdder::IOType& inputs, const std::vector<long>& soln,
+                    long nextSoln, Bits& outputs) {
     BitAdder::IOType::iterator iterA = inputs.begin();
     while ( iterA != inputs.end() ) {
+      if ( 0 == *iterA ) // the unused zero pad of a single row
+        *iterA = constantVar(0);
       if ( nextSoln < static_cast<long>(soln.size()) )
-        setValue(*iterA, soln[nextSoln++]);
+        pinOutput(*iterA, soln[nextSoln++], outputs);
       else
         setValue(*iterA, 0);
       ++iterA;
     } // while
-    NotGreaterEqualN m1gen(Ax[0], Ax[multBits-1], outputs, nextVar_);
-    NotGreaterEqualN m2gen(Bx[0], Bx[multBits-1], outputs, nextVar_);
   }
 
-  long GetTotalInputBits() const {
-    return(max_);
+  // One row (past the first) of the array, for a worker thread: the
+  //  partial products a*B take variables base+1..base+|B| and the row's
+  //  BitAdder the next 2|B|, whatever else is being built at the time
+  struct ArrayRow {
+    ArrayRow() : a_(0), b_(0), base_(0), halfAdders_(0), ok_(false)
+    { /* */ }
+
+    long a_;
+    const Bits* b_;
+    long base_;
+    BitAdder::IOType carry_, out_; // from the row above; of this row
+    ClauseDB cnf_;
+    EncoderStats stats_;
+    long halfAdders_;
+    bool ok_;
+  };
+
+  struct RowWorker {
+    std::vector<ArrayRow>* rows_;
+    std::size_t first_, step_;
+  };
+
+  static void* buildRows(void* arg) {
+    RowWorker* w = static_cast<RowWorker*>(arg);
+    long cells = halfAdderCells; // nonzero when run by the main thread
+    for ( std::size_t r = w->first_; r < w->rows_->size(); r += w->step_ ) {
+      ArrayRow& row = (*w->rows_)[r];
+      rowCNF = &row.cnf_;
+      rowStats = &row.stats_;
+      halfAdderCells = 0;
+      try {
+        row.cnf_.Tagging(gates.polarity_);
+        std::size_t bitsB = row.b_->size();
+        BitAdder::IOType inputs(2 * bitsB);
+        for ( std::size_t inner = 0; inner < bitsB; ++inner ) {
+          andGate(row.base_ + 1 + static_cast<long>(inner), row.a_, (*row.b_)[inner]);
+          inputs[2 * inner] = row.carry_[inner]; // as arrayProduct() pairs them
+          inputs[2 * inner + 1] = row.base_ + 1 + static_cast<long>(inner);
+        } // for
+        BitAdder ba(inputs, row.base_ + static_cast<long>(bitsB));
+        row.out_ = ba.Output();
+        row.ok_ = true;
+      } catch(...) {
+        /* already output error msg */
+      }
+      row.halfAdders_ = halfAdderCells;
+      rowCNF = 0;
+      rowStats = 0;
+    } // for
+    halfAdderCells = cells;
+    return(0);
   }
 
-private:
-  void makeAndEq(long a, long b) {
+  // arrayProduct() with the rows below the first built by 'threads' worker
+  //  threads, a batch at a time.  Every row's variables are known up front
+  //  (|B| ANDs, then |B| adder cells of two outputs each), so workers fill
+  //  one ClauseDB per row and the rows are appended in order, each followed
+  //  by the product bit pin the serial code writes there: the output is the
+  //  same, byte for byte.
+  void parallelArrayProduct(const Bits& Ax, const Bits& Bx, const std::vector<long>& soln,
+                            Bits& outputs, long threads) {
+    std::size_t multBits = soln.size(), bitsA = Ax.size(), bitsB = Bx.size();
+    long nextSoln = 0, cells = 3 * static_cast<long>(bitsB);
+
+    // First row, as in arrayProduct()
+    BitAdder::IOType carry;
+    for ( std::size_t inner = 0; inner < bitsB; ++inner ) {
+      makeAndEq(Ax[0], Bx[inner]);
+      if ( !inner )
+        pinOutput(nextVar_, soln[nextSoln++], outputs);
+      else
+        carry.push_back(nextVar_);
+    } // for
+    carry.push_back(gates.halfAdders_ ? 0 : constantVar(0));
+    FlushCNF();
+
+    std::size_t batch = 4 * static_cast<std::size_t>(threads);
+    std::vector<ArrayRow> rows;
+    std::vector<RowWorker> workers(threads);
+    std::vector<pthread_t> ids(threads);
+    for ( std::size_t start = 1; start < bitsA; start += batch ) {
+      rows.assign(std::min(batch, bitsA - start), ArrayRow());
+      for ( std::size_t r = 0; r < rows.size(); ++r ) {
+        rows[r].a_ = Ax[start + r];
+        rows[r].b_ = &Bx;
+        rows[r].base_ = nextVar_ + static_cast<long>(r) * cells;
+        if ( !r )
+          rows[r].carry_ = carry;
+        else { // the row above's outputs past the lowest: sums 1..|B|-1, then its carry
+          long adder = rows[r-1].base_ + static_cast<long>(bitsB);
+          for ( std::size_t k = 1; k < bitsB; ++k )
+            rows[r].carry_.push_back(adder + 2 * static_cast<long>(k) + 1);
+          rows[r].carry_.push_back(adder + 2 * static_cast<long>(bitsB));
+        }
+      } // for
+
+      std::vector<bool> started(threads, false);
+      for ( long t = 0; t < threads; ++t ) {
+        workers[t].rows_ = &rows;
+        workers[t].first_ = t;
+        workers[t].step_ = threads;
+        started[t] = (0 == pthread_create(&ids[t], 0, buildRows, &workers[t]));
+      } // for
+      for ( long t = 0; t < threads; ++t ) {
+        if ( started[t] )
+          pthread_join(ids[t], 0);
+        else // no thread to be had: build its rows here
+          buildRows(&workers[t]);
+      } // for
+
+      for ( std::size_t r = 0; r < rows.size(); ++r ) {
+        if ( !rows[r].ok_ )
+          throw(BAD);
+        outputCNF.Append(rows[r].cnf_);
+        halfAdderCells += rows[r].halfAdders_;
+        encoderStats.Add(rows[r].stats_);
+        BitAdder::IOType& out = rows[r].out_;
+        if ( nextSoln < static_cast<long>(multBits) )
+          pinOutput(out[0], soln[nextSoln++], outputs);
+        else
+          setValue(out[0], 0);
+        carry.assign(out.begin() + 1, out.end());
+        nextVar_ = rows[r].base_ + cells;
+        FlushCNF();
+      } // for
+    } // for
+
+    pinRemaining(carry, soln, nextSoln, outputs);
+  }
+
+  // Truncated array: only partial products and adder cells of weight below
+  //  N's width are built.  Everything above is replaced by 'no overflow'
+  //  clauses: a_i*b_j is false for i+j >= n, and a carry out of the top
+  //  column is false.
+  void truncatedProduct(const Bits& Ax, const Bits& Bx,
+                        const std::vector<long>& soln, Bits& outputs) {
+    std::size_t n = soln.size();
+    std::size_t rows = std::min(Ax.size(), n);
+    Bits acc; // acc[k] has weight idx+k
+    for ( std::size_t idx = 0; idx < Ax.size(); ++idx ) {
+      for ( std::size_t inner = (idx < n ? n - idx : 0); inner < Bx.size(); ++inner )
+        KeepCNF(-Ax[idx], -Bx[inner]);
+      if ( idx >= rows ) {
+        FlushCNF();
+        continue;
+      }
+
+      Bits row, sums;
+      for ( std::size_t inner = 0; inner < Bx.size() && idx + inner < n; ++inner ) {
+        makeAndEq(Ax[idx], Bx[inner]);
+        row.push_back(nextVar_);
+      } // for
+
+      long carry = 0;
+      std::size_t len = std::max(acc.size(), row.size());
+      for ( std::size_t k = 0; k < len; ++k ) {
+        long x = k < acc.size() ? acc[k] : 0;
+        long y = k < row.size() ? row[k] : 0;
+        sums.push_back(addBits(carry, x, y, carry));
+      } // for
+      if ( carry ) {
+        if ( idx + len < n )
+          sums.push_back(carry);
+        else
+          setValue(carry, 0);
+      }
+
+      pinOutput(sums[0], soln[idx], outputs);
+      acc.assign(sums.begin() + 1, sums.end());
+      FlushCNF();
+    } // for
+
+    for ( std::size_t k = 0; k < acc.size(); ++k ) {
+      pinOutput(acc[k], soln[rows + k], outputs);
+    } // for
+    // Bits no partial product reaches (a narrow factor): still pinned, as
+    //  in pinProduct(), so a set bit of N there is unsatisfiable
+    for ( std::size_t k = rows + acc.size(); k < n; ++k )
+      pinOutput(constantVar(0), soln[k], outputs);
+  }
+
+  // Carry-save tree: all partial products are dropped into columns by
+  //  weight, FullAdder and half adder cells compress every column to at
+  //  most two bits (Wallace: greedily per stage; Dadda: only as much as the
+  //  next stage's height limit requires), and one ripple adder finishes.
+  void treeProduct(const Bits& Ax, const Bits& Bx,
+                   const std::vector<long>& soln, Bits& outputs,
+                   const Encoding& enc) {
+    std::size_t n = soln.size();
+    std::size_t width = enc.truncate_ ? n : Ax.size() + Bx.size();
+    std::vector<Bits> cols(width);
+    for ( std::size_t idx = 0; idx < Ax.size(); ++idx ) {
+      for ( std::size_t inner = 0; inner < Bx.size(); ++inner ) {
+        if ( idx + inner < width ) {
+          makeAndEq(Ax[idx], Bx[inner]);
+          cols[idx + inner].push_back(nextVar_);
+        }
+        else
+          KeepCNF(-Ax[idx], -Bx[inner]);
+      } // for
+      FlushCNF();
+    } // for
+
+    std::size_t height = 0;
+    for ( std::size_t k = 0; k < width; ++k )
+      height = std::max(height, cols[k].size());
+
+    if ( enc.mult_ == Encoding::Dadda ) {
+      std::vector<std::size_t> limits(1, 2);
+      while ( limits.back() * 3 / 2 < height )
+        limits.push_back(limits.back() * 3 / 2);
+      while ( height > 2 && !limits.empty() ) {
+        daddaStage(cols, limits.back());
+        height = limits.back();
+        limits.pop_back();
+        FlushCNF();
+      } // while
+    } else {
+      while ( height > 2 ) {
+        height = wallaceStage(cols);
+        FlushCNF();
+      } // while
+    }
+
+    // Final carry-propagate adder
+    Bits product(width);
+    long carry = 0;
+    for ( std::size_t k = 0; k < width; ++k ) {
+      long x = cols[k].size() > 0 ? cols[k][0] : 0;
+      long y = cols[k].size() > 1 ? cols[k][1] : 0;
+      product[k] = addBits(carry, x, y, carry);
+    } // for
+    if ( carry )
+      setValue(carry, 0);
+    pinProduct(product, soln, outputs);
+    FlushCNF();
+  }
+
+  // Karatsuba: with A = A1*2^m + A0 and B = B1*2^m + B0,
+  //   A*B = z2*2^2m + z1*2^m + z0  where  z0 = A0*B0,  z2 = A1*B1,
+  //   z1 = (A0+A1)*(B0+B1) - z0 - z2
+  //  so each level needs three half-size products rather than four.  Below
+  //  'threshold' bits the schoolbook array is used.
+  Bits karatsuba(const Bits& A, const Bits& B, std::size_t threshold) {
+    std::size_t shorter = std::min(A.size(), B.size());
+    std::size_t longer = std::max(A.size(), B.size());
+    if ( shorter <= threshold || longer < 4 ) // (m+1)-bit sums must shrink
+      return(schoolbook(A, B));
+
+    std::size_t m = (longer + 1) / 2;
+    if ( shorter <= m ) { // unbalanced: split the longer factor only
+      const Bits& L = A.size() >= B.size() ? A : B;
+      const Bits& S = A.size() >= B.size() ? B : A;
+      Bits L0(L.begin(), L.begin() + m), L1(L.begin() + m, L.end());
+      Bits rtn = karatsuba(L0, S, threshold);
+      addInto(rtn, karatsuba(L1, S, threshold), m);
+      rtn.resize(A.size() + B.size(), 0);
+      return(rtn);
+    }
+
+    Bits A0(A.begin(), A.begin() + m), A1(A.begin() + m, A.end());
+    Bits B0(B.begin(), B.begin() + m), B1(B.begin() + m, B.end());
+    Bits z0 = karatsuba(A0, B0, threshold);
+    Bits z2 = karatsuba(A1, B1, threshold);
+    Bits sumA(A0), sumB(B0);
+    addInto(sumA, A1, 0);
+    addInto(sumB, B1, 0);
+    Bits z1 = karatsuba(sumA, sumB, threshold);
+    z1.resize(2 * m + 2, 0); // z1 < 2^(2m+1): the subtractions cannot wrap
+    subtractFrom(z1, z0);
+    subtractFrom(z1, z2);
+
+    Bits rtn(z0);
+    addInto(rtn, z1, m);
+    addInto(rtn, z2, 2 * m);
+    rtn.resize(A.size() + B.size(), 0); // higher bits are provably zero
+    FlushCNF();
+    return(rtn);
+  }
+
+  // Schoolbook array of AND rows, each rippled into the running sum
+  Bits schoolbook(const Bits& A, const Bits& B) {
+    Bits acc;
+    for ( std::size_t idx = 0; idx < A.size(); ++idx ) {
+      Bits row(B.size(), 0);
+      for ( std::size_t inner = 0; inner < B.size(); ++inner ) {
+        if ( A[idx] && B[inner] ) {
+          makeAndEq(A[idx], B[inner]);
+          row[inner] = nextVar_;
+        }
+      } // for
+      addInto(acc, row, idx);
+    } // for
+    acc.resize(A.size() + B.size(), 0);
+    return(acc);
+  }
+
+  // acc += X * 2^shift, growing acc by a carry bit when one can occur
+  void addInto(Bits& acc, const Bits& X, std::size_t shift) {
+    if ( acc.size() < shift + X.size() )
+      acc.resize(shift + X.size(), 0);
+    long carry = 0;
+    std::size_t k = shift;
+    for ( ; k < acc.size() && (k < shift + X.size() || carry); ++k ) {
+      long x = k < shift + X.size() ? X[k - shift] : 0;
+      acc[k] = addBits(carry, acc[k], x, carry);
+    } // for
+    if ( carry )
+      acc.push_back(carry);
+  }
+
+  // acc -= X modulo 2^acc.size(), as acc + ~X + 1.  Constant bits of ~X and
+  //  the carry-in of 1 come from a single variable pinned true.
+  void subtractFrom(Bits& acc, const Bits& X) {
+    long carry = trueVar();
+    for ( std::size_t k = 0; k < acc.size(); ++k ) {
+      long x = (k < X.size() && X[k]) ? -X[k] : trueVar();
+      acc[k] = addBits(carry, acc[k], x, carry);
+    } // for
+  }
+
+  long trueVar() {
+    if ( 0 == trueVar_ )
+      trueVar_ = constantVar(1);
+    return(trueVar_);
+  }
+
+  // A new variable with a fixed value: a unit clause, or in AIG mode a
+  //  constant the circuit folds away
+  long constantVar(long value) {
     ++nextVar_;
-    Clause::LitType lt;
-    lt.insert(-nextVar_); lt.insert(a);
-    Clause c1(lt);
-    lt.clear();
+    Tally().vars_[EncoderStats::Units] += 1;
+    if ( circuit )
+      circuit->SetConstant(nextVar_, value != 0);
+    else
+      setValue(nextVar_, value);
+    return(nextVar_);
+  }
+
+  // Pins product bits to N, and to zero above its width.  Entries of 0 are
+  //  bits no partial product can reach; below N's width they still need a
+  //  variable so a set bit of N makes the instance unsatisfiable.
+  void pinProduct(const Bits& product, const std::vector<long>& soln,
+                  Bits& outputs) {
+    for ( std::size_t k = 0; k < product.size(); ++k ) {
+      long bit = product[k];
+      if ( k >= soln.size() ) {
+        if ( bit )
+          setValue(bit, 0);
+        continue;
+      } else if ( 0 == bit )
+        bit = constantVar(0);
+      pinOutput(bit, soln[k], outputs);
+    } // for
+  }
+
+  // One Wallace stage: every group of three bits in a column goes through
+  //  a FullAdder, and a pair left over in a column that needed one goes
+  //  through a half adder.  Returns the new maximum column height.
+  std::size_t wallaceStage(std::vector<Bits>& cols) {
+    std::vector<Bits> next(cols.size());
+    for ( std::size_t k = 0; k < cols.size(); ++k ) {
+      const Bits& col = cols[k];
+      std::size_t pos = 0;
+      long carry = 0;
+      for ( ; col.size() - pos >= 3; pos += 3 ) {
+        next[k].push_back(addBits(col[pos], col[pos+1], col[pos+2], carry));
+        keepCarry(next, k + 1, carry);
+      } // for
+      if ( pos > 0 && col.size() - pos == 2 ) {
+        next[k].push_back(addBits(0, col[pos], col[pos+1], carry));
+        keepCarry(next, k + 1, carry);
+        pos += 2;
+      }
+      next[k].insert(next[k].end(), col.begin() + pos, col.end());
+    } // for
+    cols.swap(next);
+
+    std::size_t height = 0;
+    for ( std::size_t k = 0; k < cols.size(); ++k )
+      height = std::max(height, cols[k].size());
+    return(height);
+  }
+
+  // One Dadda stage: reduce each column, including carries arriving from
+  //  the column below in this same stage, to at most 'limit' bits.
+  void daddaStage(std::vector<Bits>& cols, std::size_t limit) {
+    for ( std::size_t k = 0; k < cols.size(); ++k ) {
+      Bits col, done;
+      col.swap(cols[k]);
+      std::size_t pos = 0;
+      long carry = 0;
+      while ( col.size() - pos + done.size() > limit && col.size() - pos >= 2 ) {
+        if ( col.size() - pos + done.size() == limit + 1 || col.size() - pos == 2 ) {
+          done.push_back(addBits(0, col[pos], col[pos+1], carry));
+          pos += 2;
+        } else {
+          done.push_back(addBits(col[pos], col[pos+1], col[pos+2], carry));
+          pos += 3;
+        }
+        keepCarry(cols, k + 1, carry);
+      } // while
+      done.insert(done.end(), col.begin() + pos, col.end());
+      cols[k].swap(done);
+    } // for
+  }
+
+  // A carry leaving the top column is a product bit that cannot be set
+  void keepCarry(std::vector<Bits>& cols, std::size_t k, long carry) {
+    if ( 0 == carry )
+      return;
+    else if ( k < cols.size() )
+      cols[k].push_back(carry);
+    else
+      setValue(carry, 0);
+  }
+
+  // Sum of up to three bits, where 0 marks an absent bit.  Returns the sum
+  //  bit and sets 'carry' to the carry bit, or to 0 when there can be none.
+  long addBits(long x, long y, long z, long& carry) {
+    // FullAdder allows only its carry-in to be absent
+    if ( 0 == y )
+      std::swap(x, y);
+    if ( 0 == z )
+      std::swap(x, z);
+    if ( 0 == y || 0 == z ) {
+      carry = 0;
+      return(y ? y : z);
+    }
+    long sVar = ++nextVar_, cVar = ++nextVar_;
+    FullAdder(x, y, z).Equivalence(sVar, cVar);
+    carry = cVar;
+    return(sVar);
+  }
+
+private:
+  // For odd N, X and Y are odd and Y = N * X^-1 mod 2^k: bit j of Y is a
+  //  function of bits 1..j of X.  One clause per pattern of those bits
+  //  states it, 2^k - 1 clauses in all.  Nothing is added for even N.
+  void lowBits(const Bits& X, const Bits& Y, const std::vector<long>& soln,
+               long depth) {
+    if ( !soln[0] )
+      return;
+    std::size_t k = std::min(static_cast<std::size_t>(depth), soln.size());
+    k = std::min(k, std::min(X.size(), Y.size()));
+    unsigned long n = 0;
+    for ( std::size_t j = 0; j < k; ++j )
+      n |= static_cast<unsigned long>(soln[j]) << j;
+    for ( std::size_t j = 0; j < k; ++j ) {
+      unsigned long mask = (2UL << j) - 1;
+      for ( unsigned long pattern = 0; pattern < (1UL << j); ++pattern ) {
+        unsigned long x = (pattern << 1) | 1, inverse = x;
+        for ( int i = 0; i < 6; ++i ) // Newton: doubles the correct bits
+          inverse *= 2 - x * inverse;
+        bool bit = (((n * inverse) & mask) >> j) & 1;
+        for ( std::size_t i = 1; i <= j; ++i )
+          outputCNF.Push(((x >> i) & 1) ? -X[i] : X[i]);
+        outputCNF.Push(bit ? Y[j] : -Y[j]);
+        CloseCNF();
+      } // for
+      FlushCNF();
+    } // for
+  }
+
+  // a*b = N (mod m): each factor's residue is tracked bit by bit through
+  //  one-hot layers of m variables, and the final residue pairs whose
+  //  product is wrong are ruled out.
+  void residueCheck(const Bits& Ax, const Bits& Bx,
+                    const std::vector<long>& soln, long m) {
+    long n = 0;
+    for ( std::size_t idx = soln.size(); idx-- > 0; )
+      n = (2 * n + soln[idx]) % m;
+    Bits ra = residue(Ax, m), rb = residue(Bx, m);
+    for ( long x = 0; x < m; ++x ) {
+      for ( long y = 0; y < m; ++y ) {
+        if ( (x * y) % m != n )
+          KeepCNF(-ra[x], -rb[y]);
+      } // for
+    } // for
+    FlushCNF();
+  }
+
+  // Final layer of the residue automaton for X mod m
+  Bits residue(const Bits& X, long m) {
+    Bits prev;
+    long weight = 1 % m;
+    for ( std::size_t i = 0; i < X.size(); ++i ) {
+      Bits cur(m);
+      for ( long r = 0; r < m; ++r )
+        cur[r] = ++nextVar_;
+      if ( prev.empty() ) {
+        KeepCNF(X[i], cur[0]);
+        KeepCNF(-X[i], cur[weight]);
+      } else {
+        for ( long r = 0; r < m; ++r ) {
+          KeepCNF(-prev[r], X[i], cur[r]);
+          KeepCNF(-prev[r], -X[i], cur[(r + weight) % m]);
+        } // for
+      }
+      for ( long r = 0; r < m; ++r ) { // exactly one
+        for ( long t = r + 1; t < m; ++t )
+          KeepCNF(-cur[r], -cur[t]);
+      } // for
+      for ( long r = 0; r < m; ++r )
+        outputCNF.Push(cur[r]);
+      CloseCNF();
+      FlushCNF();
+      prev.swap(cur);
+      weight = (2 * weight) % m;
+    } // for
+    return(prev);
+  }
 
-    lt.insert(-nextVar_); lt.insert(b);
-    Clause c2(lt);
-    lt.clear();
+  void makeAndEq(long a, long b) {
+    andGate(++nextVar_, a, b);
+  }
 
-    lt.insert(-a); lt.insert(-b); lt.insert(nextVar_);
-    Clause c3(lt);
+  static void andGate(long out, long a, long b) {
+    Tally(EncoderStats::AndGates, 1);
+    Component scope(EncoderStats::AndGates);
+    if ( circuit ) {
+      circuit->DefineAnd(out, a, b);
+      return;
+    }
+    Sink().Define(out);
+    KeepCNF(-out, a);
+    KeepCNF(-out, b);
+    KeepCNF(-a, -b, out);
+    Sink().Define(0);
+  }
 
-    Container cont;
-    cont.push_back(c1);
-    cont.push_back(c2);
-    cont.push_back(c3);
-    KeepCNF(cont);
+  // A product bit below N's width: set to N's bit, or in template mode
+  //  left open for per-number assumptions
+  void pinOutput(long var, long value, Bits& outputs) {
+    if ( !template_ )
+      setValue(var, value);
+    outputs.push_back(var);
   }
 
   void setValue(long var, long value) {
+    Tally(EncoderStats::Units, 0);
+    Component scope(EncoderStats::Units);
     if ( value )
       KeepCNF(var);
     else
@@ -454,9 +2400,460 @@ private:
   }
 
 private:
-  long nextVar_, max_;
+  long nextVar_, trueVar_, widthA_, widthB_;
+  bool template_;
+  Bits outputs_;
+};
+
+
+//=========
+// Options
+//=========
+struct Options {
+  Options() : stream_(false), half_(false), count_(false), aig_(false),
+              simplify_(false), cubes_(0), base_(2)
+  { /* */ }
+
+  std::string number_;
+  bool stream_, half_, count_, aig_, simplify_;
+  long cubes_, base_;
+  std::string cubeFiles_, variant_, stats_;
+  std::string templateFile_, templateFiles_;
+  std::vector<std::string> numbers_; // template mode: every N to assume
+  Encoding enc_;
+  GateStyle gates_;
 };
 
+std::string Usage() {
+  std::string rtn = "iencode [options] <binary integer>";
+  rtn += "\nExample: iencode 10101";
+  rtn += "\n  to encode decimal 21 as a SATISFIABILITY problem.";
+  rtn += "\n\nOptions:";
+  rtn += "\n  --base=2|10|16";
+  rtn += "\n               read N (and --template numbers) in binary (the";
+  rtn += "\n               default), decimal or hexadecimal; a 0x prefix always";
+  rtn += "\n               means hexadecimal.  The header records N in decimal";
+  rtn += "\n  --stream     emit each multiplier row as soon as it is built, keeping";
+  rtn += "\n               memory bounded; when stdout is not a regular file the";
+  rtn += "\n               circuit is walked twice so the header can be written first";
+  rtn += "\n  --half       encode a ceil(n/2)-bit by n-bit multiplier for an n-bit";
+  rtn += "\n               input; the smaller factor of any nontrivial factorization";
+  rtn += "\n               fits in ceil(n/2) bits";
+  rtn += "\n  --widths A,B give the two factors A and B bits (A+B must reach n)";
+  rtn += "\n  --truncate   build only partial products and adders below weight n;";
+  rtn += "\n               the high half becomes 'no overflow' clauses";
+  rtn += "\n  --multiplier=array|wallace|dadda|karatsuba";
+  rtn += "\n               reduce partial products with rows of ripple-carry";
+  rtn += "\n               BitAdders (array, the default) or with a carry-save";
+  rtn += "\n               Wallace or Dadda tree and one final adder; or split";
+  rtn += "\n               the factors recursively (Karatsuba, O(n^1.58) gates)";
+  rtn += "\n  --karatsuba-threshold=T";
+  rtn += "\n               Karatsuba uses the schoolbook array once a factor has";
+  rtn += "\n               at most T bits (default 16)";
+  rtn += "\n  --threads=T  build the rows of the array multiplier on T threads; the";
+  rtn += "\n               output is identical (other multipliers, --truncate and";
+  rtn += "\n               --aig build on one)";
+  rtn += "\n  --half-adders";
+  rtn += "\n               use 7-clause half adder cells wherever an adder has no";
+  rtn += "\n               carry-in, instead of a FullAdder with a zero carry-in";
+  rtn += "\n  --adder=plain|strong";
+  rtn += "\n               strong adds clauses tying each adder's sum and carry";
+  rtn += "\n               together, for stronger unit propagation";
+  rtn += "\n  --xor        write adder sum bits as native XOR constraints ('x'";
+  rtn += "\n               lines, as read by CryptoMiniSat and other solvers with";
+  rtn += "\n               Gaussian elimination); carries stay CNF";
+  rtn += "\n  --polarity   keep only the implication directions of each gate that";
+  rtn += "\n               the instance relies on (Plaisted-Greenbaum)";
+  rtn += "\n  --aig        build the circuit as an and-inverter graph with XOR and";
+  rtn += "\n               majority nodes first: duplicate gates are merged and";
+  rtn += "\n               constants propagated before any clause is written";
+  rtn += "\n               (--adder=strong has no effect here)";
+  rtn += "\n  --simplify   run unit propagation on the finished CNF, drop what it";
+  rtn += "\n               settles and renumber the remaining variables densely;";
+  rtn += "\n               the 'c meta factor' comments let extract-sat find";
+  rtn += "\n               the factor bits";
+  rtn += "\n  --bounds=ordered|legacy";
+  rtn += "\n               ordered (the default) requires the narrower factor to";
+  rtn += "\n               be at most the wider and neither to be 1, in clauses";
+  rtn += "\n               linear in n; legacy keeps the original comparators of";
+  rtn += "\n               each factor against N (quadratic, no symmetry breaking)";
+  rtn += "\n  --modular=K  for odd N, tie the low K bits of each factor to the";
+  rtn += "\n               other's via a*b = N mod 2^K (2^K - 1 clauses per factor;";
+  rtn += "\n               K is at most 20)";
+  rtn += "\n  --residues=M,M,...";
+  rtn += "\n               add redundant checks a*b = N mod M for small odd M";
+  rtn += "\n               (e.g. 3,5,7,31), one-hot residue variables per factor bit";
+  rtn += "\n  --cubes=K    split the instance on the top K bits the smaller factor";
+  rtn += "\n               can have: write iCNF with one 'a' line per cube (2^K)";
+  rtn += "\n  --cube-files=PREFIX";
+  rtn += "\n               with --cubes, write each cube as a standalone CNF,";
+  rtn += "\n               PREFIX.<i>.cnf, and list them in PREFIX.manifest";
+  rtn += "\n  --template=FILE";
+  rtn += "\n               encode the multiplier once for every number in FILE";
+  rtn += "\n               (binary, one per line, all of the same width; - for";
+  rtn += "\n               stdin): iCNF with one 'a' line of product bits per";
+  rtn += "\n               number, in order.  No number is given on the command line";
+  rtn += "\n  --template-files=PREFIX";
+  rtn += "\n               with --template, write the multiplier to PREFIX.cnf and";
+  rtn += "\n               each number's product bits as unit clauses to";
+  rtn += "\n               PREFIX.<i>.units";
+  rtn += "\n  --count      print variable and clause counts of every multiplier";
+  rtn += "\n               variant under the other options, instead of the CNF";
+  rtn += "\n  --compress=gzip|xz|zstd";
+  rtn += "\n               pipe the CNF through the compressor as it is written;";
+  rtn += "\n               cube shards and the template's multiplier get a .gz,";
+  rtn += "\n               .xz or .zst suffix";
+  rtn += "\n  --format=dimacs|binary";
+  rtn += "\n               binary writes 'p bincnf' and varint-delta encoded";
+  rtn += "\n               clauses after the usual comments (see README); not";
+  rtn += "\n               for iCNF";
+  rtn += "\n  --stats[=human|json]";
+  rtn += "\n               report on standard error the variables, clauses and";
+  rtn += "\n               literals of each component (AND gates, FullAdder cells,";
+  rtn += "\n               BitAdder rows, comparators, units), the wall time of";
+  rtn += "\n               parsing, building and output, and the peak RSS";
+  return(rtn);
+}
+
+namespace { // unnamed
+  // Accepts both '--name value' and '--name=value'
+  bool OptionValue(const std::string& arg, const std::string& name,
+                   int& i, int argc, char* argv[], std::string& value) {
+    if ( arg == name ) {
+      if ( ++i == argc ) {
+        std::cerr << "Missing value for " << name << std::endl;
+        throw(BAD);
+      }
+      value = argv[i];
+      return(true);
+    } else if ( arg.compare(0, name.size() + 1, name + "=") == 0 ) {
+      value = arg.substr(name.size() + 1);
+      return(true);
+    }
+    return(false);
+  }
+
+  // N as binary digits.  Binary input is kept as given, leading zeros and
+  //  all, since they set the multiplier's width.
+  std::string BinaryDigits(const std::string& str, long base) {
+    try {
+      if ( str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X') )
+        return(BigInt::FromHex(str.substr(2)).ToBinary());
+      else if ( 10 == base )
+        return(BigInt::FromDecimal(str).ToBinary());
+      else if ( 16 == base )
+        return(BigInt::FromHex(str).ToBinary());
+    } catch(std::string& s) {
+      std::cerr << s << std::endl;
+      throw(BAD);
+    }
+    return(str);
+  }
+
+  // One number per line ('-' is stdin), in the --base given; all must have
+  //  the same width in binary
+  std::vector<std::string> ReadNumbers(const std::string& name, long base) {
+    std::ifstream file;
+    if ( name != "-" )
+      file.open(name.c_str());
+    std::istream& in = (name == "-") ? std::cin : file;
+    if ( !in ) {
+      std::cerr << "Unable to read " << name << std::endl;
+      throw(BAD);
+    }
+    std::vector<std::string> numbers;
+    std::string line;
+    while ( in >> line ) {
+      line = BinaryDigits(line, base);
+      if ( !numbers.empty() && line.size() != numbers[0].size() ) {
+        std::cerr << "--template: " << line << " is not " << numbers[0].size()
+                  << " bits wide like the first number" << std::endl;
+        throw(BAD);
+      }
+      numbers.push_back(line);
+    } // while
+    if ( numbers.empty() ) {
+      std::cerr << "--template: no numbers in " << name << std::endl;
+      throw(BAD);
+    }
+    return(numbers);
+  }
+
+  long PositiveNumber(const std::string& str, const std::string& name) {
+    std::stringstream convert(str);
+    long value = 0;
+    if ( str.empty() || str.find_first_not_of("0123456789") != std::string::npos
+         || !(convert >> value) || value <= 0 ) {
+      std::cerr << "Bad value for " << name << ": " << str << std::endl;
+      throw(BAD);
+    }
+    return(value);
+  }
+
+  // --stats on standard error.  'stats' and 'vars' are the multiplier as
+  //  built; 'written' the variables, clauses and literals of the CNF written
+  //  (after --aig, --polarity or --simplify); 'seconds' the wall time to
+  //  parse, build and output.
+  void ReportStats(const std::string& style, EncoderStats stats, long vars,
+                   const long written[3], const double seconds[3]) {
+    long total[3] = { vars, 0, 0 };
+    stats.vars_[EncoderStats::Other] = vars;
+    for ( int p = 0; p < EncoderStats::Parts; ++p ) {
+      if ( p != EncoderStats::Other )
+        stats.vars_[EncoderStats::Other] -= stats.vars_[p];
+      total[1] += stats.clauses_[p];
+      total[2] += stats.literals_[p];
+    } // for
+    struct rusage usage;
+    long peakKB = (0 == getrusage(RUSAGE_SELF, &usage)) ? usage.ru_maxrss : 0;
+    const char* phases[] = { "parse", "build", "output" };
+
+    std::stringstream out;
+    out << std::fixed << std::setprecision(6);
+    if ( style == "json" ) {
+      out << "{\"components\": {";
+      for ( int p = 0; p < EncoderStats::Parts; ++p ) {
+        std::string name = EncoderStats::Name(p);
+        std::replace(name.begin(), name.end(), ' ', '_');
+        out << (p ? ", " : "") << "\"" << name << "\": {\"count\": " << stats.count_[p]
+            << ", \"variables\": " << stats.vars_[p] << ", \"clauses\": " << stats.clauses_[p]
+            << ", \"literals\": " << stats.literals_[p] << "}";
+      } // for
+      out << "}, \"total\": {\"variables\": " << total[0] << ", \"clauses\": " << total[1]
+          << ", \"literals\": " << total[2] << "}, \"written\": {\"variables\": " << written[0]
+          << ", \"clauses\": " << written[1] << ", \"literals\": " << written[2] << "}, \"seconds\": {";
+      for ( int i = 0; i < 3; ++i )
+        out << (i ? ", " : "") << "\"" << phases[i] << "\": " << seconds[i];
+      out << "}, \"peak_rss_kb\": " << peakKB << "}";
+    } else {
+      out << std::left << std::setw(16) << "component" << std::right << std::setw(12) << "count"
+          << std::setw(14) << "variables" << std::setw(14) << "clauses" << std::setw(14) << "literals";
+      for ( int p = 0; p < EncoderStats::Parts; ++p ) {
+        out << "\n" << std::left << std::setw(16) << EncoderStats::Name(p) << std::right
+            << std::setw(12) << stats.count_[p] << std::setw(14) << stats.vars_[p]
+            << std::setw(14) << stats.clauses_[p] << std::setw(14) << stats.literals_[p];
+      } // for
+      out << "\n" << std::left << std::setw(28) << "total" << std::right << std::setw(14) << total[0]
+          << std::setw(14) << total[1] << std::setw(14) << total[2];
+      out << "\n" << std::left << std::setw(28) << "written" << std::right << std::setw(14) << written[0]
+          << std::setw(14) << written[1] << std::setw(14) << written[2];
+      out << "\nseconds:";
+      for ( int i = 0; i < 3; ++i )
+        out << " " << phases[i] << " " << seconds[i];
+      out << "\npeak RSS: " << peakKB << " KB";
+    }
+    std::cerr << out.str() << std::endl;
+  }
+} // unnamed
+
+Options ParseArgs(int argc, char* argv[]) {
+  Options opts;
+  std::string value;
+  for ( int i = 1; i < argc; ++i ) {
+    std::string arg = argv[i];
+    int first = i;
+    if ( arg == "--stream" ) {
+      opts.stream_ = true;
+      continue; // the same formula: not part of the variant
+    }
+    else if ( arg == "--half" )
+      opts.half_ = true;
+    else if ( arg == "--truncate" )
+      opts.enc_.truncate_ = true;
+    else if ( arg == "--count" )
+      opts.count_ = true;
+    else if ( arg == "--half-adders" )
+      opts.gates_.halfAdders_ = true;
+    else if ( arg == "--polarity" )
+      opts.gates_.polarity_ = true;
+    else if ( arg == "--xor" )
+      opts.gates_.xor_ = true;
+    else if ( arg == "--aig" )
+      opts.aig_ = true;
+    else if ( arg == "--simplify" )
+      opts.simplify_ = true;
+    else if ( OptionValue(arg, "--adder", i, argc, argv, value) ) {
+      if ( value == "plain" || value == "strong" )
+        opts.gates_.strong_ = (value == "strong");
+      else {
+        std::cerr << "Bad value for --adder: " << value << std::endl;
+        throw(BAD);
+      }
+    }
+    else if ( OptionValue(arg, "--multiplier", i, argc, argv, value) ) {
+      if ( value == "array" )
+        opts.enc_.mult_ = Encoding::Array;
+      else if ( value == "wallace" )
+        opts.enc_.mult_ = Encoding::Wallace;
+      else if ( value == "dadda" )
+        opts.enc_.mult_ = Encoding::Dadda;
+      else if ( value == "karatsuba" )
+        opts.enc_.mult_ = Encoding::Karatsuba;
+      else {
+        std::cerr << "Bad value for --multiplier: " << value << std::endl;
+        throw(BAD);
+      }
+    }
+    else if ( OptionValue(arg, "--widths", i, argc, argv, value) ) {
+      std::string::size_type comma = value.find(',');
+      if ( comma == std::string::npos ) {
+        std::cerr << "Bad value for --widths: expect A,B" << std::endl;
+        throw(BAD);
+      }
+      opts.enc_.widthA_ = PositiveNumber(value.substr(0, comma), "--widths");
+      opts.enc_.widthB_ = PositiveNumber(value.substr(comma + 1), "--widths");
+    }
+    else if ( OptionValue(arg, "--karatsuba-threshold", i, argc, argv, value) )
+      opts.enc_.threshold_ = PositiveNumber(value, "--karatsuba-threshold");
+    else if ( OptionValue(arg, "--threads", i, argc, argv, value) ) {
+      opts.enc_.threads_ = PositiveNumber(value, "--threads");
+      if ( opts.enc_.threads_ > 256 ) {
+        std::cerr << "Bad value for --threads: at most 256" << std::endl;
+        throw(BAD);
+      }
+      continue; // the output is the same: not part of the variant
+    }
+    else if ( OptionValue(arg, "--compress", i, argc, argv, value) ) {
+      if ( value != "gzip" && value != "xz" && value != "zstd" ) {
+        std::cerr << "Bad value for --compress: " << value << std::endl;
+        throw(BAD);
+      }
+      output.compress_ = value;
+      continue; // the same formula: not part of the variant
+    }
+    else if ( OptionValue(arg, "--format", i, argc, argv, value) ) {
+      if ( value != "dimacs" && value != "binary" ) {
+        std::cerr << "Bad value for --format: " << value << std::endl;
+        throw(BAD);
+      }
+      output.binary_ = (value == "binary");
+      continue;
+    }
+    else if ( arg == "--stats" || arg.compare(0, 8, "--stats=") == 0 ) {
+      opts.stats_ = (arg == "--stats") ? "human" : arg.substr(8);
+      if ( opts.stats_ != "human" && opts.stats_ != "json" ) {
+        std::cerr << "Bad value for --stats: " << opts.stats_ << std::endl;
+        throw(BAD);
+      }
+      continue;
+    }
+    else if ( OptionValue(arg, "--base", i, argc, argv, value) ) {
+      if ( value == "2" || value == "10" || value == "16" )
+        opts.base_ = PositiveNumber(value, "--base");
+      else {
+        std::cerr << "Bad value for --base: " << value << std::endl;
+        throw(BAD);
+      }
+    }
+    else if ( OptionValue(arg, "--cubes", i, argc, argv, value) ) {
+      opts.cubes_ = PositiveNumber(value, "--cubes");
+      if ( opts.cubes_ > 20 ) {
+        std::cerr << "Bad value for --cubes: at most 20" << std::endl;
+        throw(BAD);
+      }
+    }
+    else if ( OptionValue(arg, "--cube-files", i, argc, argv, value) )
+      opts.cubeFiles_ = value;
+    else if ( OptionValue(arg, "--template", i, argc, argv, value) )
+      opts.templateFile_ = value;
+    else if ( OptionValue(arg, "--template-files", i, argc, argv, value) )
+      opts.templateFiles_ = value;
+    else if ( OptionValue(arg, "--bounds", i, argc, argv, value) ) {
+      if ( value == "ordered" )
+        opts.enc_.bounds_ = Encoding::Ordered;
+      else if ( value == "legacy" )
+        opts.enc_.bounds_ = Encoding::Legacy;
+      else {
+        std::cerr << "Bad value for --bounds: " << value << std::endl;
+        throw(BAD);
+      }
+    }
+    else if ( OptionValue(arg, "--modular", i, argc, argv, value) ) {
+      opts.enc_.modular_ = PositiveNumber(value, "--modular");
+      if ( opts.enc_.modular_ > 20 ) {
+        std::cerr << "Bad value for --modular: at most 20" << std::endl;
+        throw(BAD);
+      }
+    }
+    else if ( OptionValue(arg, "--residues", i, argc, argv, value) ) {
+      std::stringstream list(value);
+      std::string modulus;
+      while ( std::getline(list, modulus, ',') ) {
+        long m = PositiveNumber(modulus, "--residues");
+        if ( m < 3 || m > 255 || 0 == m % 2 ) {
+          std::cerr << "Bad value for --residues: moduli must be odd, 3 to 255" << std::endl;
+          throw(BAD);
+        }
+        opts.enc_.residues_.push_back(m);
+      } // while
+    }
+    else if ( arg.empty() || arg[0] == '-' || !opts.number_.empty() ) {
+      std::cerr << "Unexpected argument: " << arg << std::endl;
+      std::cerr << "use iencode -h for help" << std::endl;
+      throw(BAD);
+    }
+    else {
+      opts.number_ = arg;
+      continue;
+    }
+
+    for ( ; first <= i; ++first ) // the options, for the 'variant' metadata
+      opts.variant_ += (opts.variant_.empty() ? "" : " ") + std::string(argv[first]);
+  } // for
+
+  if ( !opts.templateFile_.empty() ) {
+    if ( !opts.number_.empty() ) {
+      std::cerr << "--template reads its numbers from a file: no number argument" << std::endl;
+      throw(BAD);
+    }
+    opts.numbers_ = ReadNumbers(opts.templateFile_, opts.base_);
+    opts.number_ = opts.numbers_[0];
+    opts.enc_.template_ = true;
+  } else if ( !opts.number_.empty() )
+    opts.number_ = BinaryDigits(opts.number_, opts.base_);
+
+  if ( opts.number_.empty() ) {
+    std::cerr << "Wrong # parameters - expect 1 binary integer" << std::endl;
+    std::cerr << "Example: iencode 10101" << std::endl;
+    std::cerr << "  to encode decimal 21 as a SATISFIABILITY problem." << std::endl;
+    std::cerr << "use iencode -h for help" << std::endl;
+    throw(BAD);
+  } else if ( opts.gates_.polarity_ && (opts.stream_ || opts.count_) ) {
+    std::cerr << "--polarity needs the whole CNF in memory: not with --stream or --count" << std::endl;
+    throw(BAD);
+  } else if ( (opts.aig_ || opts.simplify_ || opts.cubes_) && (opts.stream_ || opts.count_) ) {
+    std::cerr << "--aig, --simplify and --cubes need the whole circuit in memory: not with --stream or --count" << std::endl;
+    throw(BAD);
+  } else if ( opts.enc_.template_ && (opts.stream_ || opts.count_ || opts.simplify_
+                                       || opts.gates_.polarity_ || opts.cubes_
+                                       || opts.enc_.modular_ || !opts.enc_.residues_.empty()) ) {
+    std::cerr << "--template leaves N open: not with --stream, --count, --simplify, --polarity,"
+              << " --cubes, --modular or --residues" << std::endl;
+    throw(BAD);
+  } else if ( !opts.templateFiles_.empty() && !opts.enc_.template_ ) {
+    std::cerr << "--template-files needs --template" << std::endl;
+    throw(BAD);
+  } else if ( !opts.cubeFiles_.empty() && !opts.cubes_ ) {
+    std::cerr << "--cube-files needs --cubes" << std::endl;
+    throw(BAD);
+  } else if ( opts.count_ && (output.binary_ || !output.compress_.empty() || !opts.stats_.empty()) ) {
+    std::cerr << "--compress, --format and --stats concern the CNF: not with --count" << std::endl;
+    throw(BAD);
+  } else if ( output.binary_ && ((opts.cubes_ && opts.cubeFiles_.empty())
+                                 || (opts.enc_.template_ && opts.templateFiles_.empty())) ) {
+    std::cerr << "--format=binary has no iCNF form: use --cube-files or --template-files" << std::endl;
+    throw(BAD);
+  } else if ( opts.half_ && opts.enc_.widthA_ ) {
+    std::cerr << "Use only one of --half and --widths" << std::endl;
+    throw(BAD);
+  } else if ( opts.half_ ) {
+    long n = static_cast<long>(opts.number_.size());
+    opts.enc_.widthA_ = (n + 1) / 2;
+    opts.enc_.widthB_ = n;
+  }
+  return(opts);
+}
+
 
 //========
 // main()
@@ -464,22 +2861,166 @@ private:
 int main(int argc, char* argv[])
 {
   try {
-    if ( argc != 2 ) {
-      std::cerr << "Wrong # parameters - expect 1 binary integer" << std::endl;
-      std::cerr << "Example: iencode 10101" << std::endl;
-      std::cerr << "  to encode decimal 21 as a SATISFIABILITY problem." << std::endl;
-      std::cerr << "use iencode -h for help" << std::endl;
-      throw(BAD);
-    } else if ( argv[1] == std::string("--help") || argv[1] == std::string("-h") ) {
-      std::cout << "Expect single integer input in binary form" << std::endl;
-      std::cout << "Example: iencode 10101" << std::endl;
-      std::cout << "  to encode decimal 21 as a SATISFIABILITY problem." << std::endl;
+    if ( argc == 2 && (argv[1] == std::string("--help") || argv[1] == std::string("-h")) ) {
+      std::cout << Usage() << std::endl;
       return(EXIT_SUCCESS);
     }
-    std::vector<long> soln = ConvertBinary(std::string(argv[1]));
-    CreateMultiplier fm(soln);
-
-    OutputCNF(std::cout, fm.GetTotalInputBits() / 2);
+    double start = Driver::Seconds();
+    Options opts = ParseArgs(argc, argv);
+    std::vector<long> soln = ConvertBinary(opts.number_);
+    std::string decimal; // N, for the header; none in template mode
+    if ( !opts.enc_.template_ && !opts.count_ )
+      decimal = BigInt::FromBinary(opts.number_).ToDecimal();
+    double parsed = Driver::Seconds(), built = parsed;
+    EncoderStats stats; // --stats: the multiplier as built, and as written
+    long builtVars = 0, written[3] = { 0, 0, 0 };
+    bool toStdout = !opts.count_ && opts.cubeFiles_.empty() && opts.templateFiles_.empty();
+    std::FILE* out = toStdout ? OpenOutput("") : stdout;
+    if ( !out ) {
+      std::cerr << "Unable to start " << output.compress_ << std::endl;
+      throw(BAD);
+    }
+    DimacsWriter dw(out);
+    dw.Binary(output.binary_);
+    gates = opts.gates_;
+    outputCNF.Tagging(gates.polarity_);
+
+    if ( opts.count_ ) {
+      const char* names[] = { "array", "wallace", "dadda", "karatsuba" };
+      Encoding::Multiplier mults[] = { Encoding::Array, Encoding::Wallace,
+                                       Encoding::Dadda, Encoding::Karatsuba };
+      std::cout << "multiplier\tvariables\tclauses" << std::endl;
+      for ( int m = 0; m < 4; ++m ) {
+        Encoding enc = opts.enc_;
+        enc.mult_ = mults[m];
+        if ( enc.truncate_ && enc.mult_ == Encoding::Karatsuba )
+          continue;
+        StreamCNF(0);
+        CreateMultiplier counter(soln, enc);
+        std::cout << names[m] << "\t" << counter.GetTotalVars()
+                  << "\t" << streamedClauses << std::endl;
+      } // for
+    } else if ( !opts.stream_ ) {
+      Aig aig;
+      if ( opts.aig_ )
+        circuit = &aig;
+      CreateMultiplier fm(soln, opts.enc_);
+      long numVars = fm.GetTotalVars();
+      builtVars = numVars;
+      std::vector<long> productBits(fm.GetProductBits());
+      std::vector<std::string> notes;
+      if ( circuit ) {
+        std::stringstream note;
+        note << "aig: " << aig.Recorded() << " definitions, " << aig.Gates()
+             << " after hashing";
+        numVars = aig.Emit(fm.GetWidthA() + fm.GetWidthB(), &productBits);
+        note << ", " << aig.Emitted() << " emitted";
+        notes.push_back(note.str());
+        circuit = 0;
+      }
+      stats = encoderStats; // with --aig, the gates as emitted
+      if ( gates.halfAdders_ ) {
+        std::stringstream note;
+        note << "half adders: " << halfAdderCells << " cells";
+        notes.push_back(note.str());
+      }
+      if ( gates.polarity_ ) {
+        std::stringstream note;
+        long before = static_cast<long>(outputCNF.Size());
+        note << "polarity: removed " << PolarityReduce(numVars)
+             << " of " << before << " clauses";
+        notes.push_back(note.str());
+      }
+      std::vector<std::string> varMap;
+      if ( opts.simplify_ ) {
+        std::stringstream note;
+        long before = static_cast<long>(outputCNF.Size()), forced = 0;
+        numVars = Simplify(numVars, fm.GetWidthA() + fm.GetWidthB(), varMap, forced);
+        note << "simplify: " << forced << " variables forced, " << outputCNF.Size()
+             << " of " << before << " clauses kept";
+        notes.push_back(note.str());
+      }
+      std::vector<std::string> meta = MetadataNotes(fm.GetWidthA(), fm.GetWidthB(),
+                                                    static_cast<long>(soln.size()), opts.variant_,
+                                                    decimal, varMap);
+      notes.insert(notes.begin(), meta.begin(), meta.end());
+      if ( !decimal.empty() )
+        notes.insert(notes.begin(), "N = " + decimal);
+      written[0] = numVars;
+      written[1] = static_cast<long>(outputCNF.Size());
+      for ( std::size_t c = 0; c < outputCNF.Size(); ++c )
+        written[2] += static_cast<long>(outputCNF.End(c) - outputCNF.Begin(c));
+      built = Driver::Seconds();
+      if ( opts.enc_.template_ ) {
+        std::stringstream note;
+        note << "template: " << opts.numbers_.size() << " numbers of "
+             << soln.size() << " bits";
+        notes.push_back(note.str());
+        Cubes pins;
+        const std::vector<long>& bits = productBits;
+        for ( std::size_t i = 0; i < opts.numbers_.size(); ++i ) {
+          std::vector<long> value = ConvertBinary(opts.numbers_[i]);
+          pins.push_back(std::vector<long>());
+          for ( std::size_t k = 0; k < bits.size(); ++k )
+            pins.back().push_back(value[k] ? bits[k] : -bits[k]);
+        } // for
+        if ( opts.templateFiles_.empty() )
+          OutputCubes(dw, fm.GetWidthA(), fm.GetWidthB(), notes, pins);
+        else
+          OutputTemplate(opts.templateFiles_, fm.GetWidthA(), fm.GetWidthB(),
+                         numVars, notes, opts.numbers_, pins);
+      } else if ( opts.cubes_ ) {
+        std::vector<long> split = CubeVariables(opts.cubes_, fm.GetWidthA(), fm.GetWidthB(),
+                                                static_cast<long>(soln.size()));
+        Cubes cubes = MakeCubes(split, varMap);
+        if ( opts.cubeFiles_.empty() )
+          OutputCubes(dw, fm.GetWidthA(), fm.GetWidthB(), notes, cubes);
+        else
+          OutputShards(opts.cubeFiles_, fm.GetWidthA(), fm.GetWidthB(), numVars, notes, cubes);
+      } else
+        OutputCNF(dw, fm.GetWidthA(), fm.GetWidthB(), numVars, notes);
+    } else {
+      long n = static_cast<long>(soln.size());
+      long widthA = opts.enc_.widthA_ ? opts.enc_.widthA_ : n;
+      long widthB = opts.enc_.widthB_ ? opts.enc_.widthB_ : n;
+      HeaderComments(dw, widthA, widthB);
+      dw.Comment("N = " + decimal);
+      std::vector<std::string> meta = MetadataNotes(widthA, widthB, n, opts.variant_, decimal,
+                                                    std::vector<std::string>());
+      for ( std::size_t i = 0; i < meta.size(); ++i )
+        dw.Comment(meta[i]);
+      if ( dw.Seekable() ) {
+        dw.Reserve();
+        StreamCNF(&dw);
+        CreateMultiplier fm(soln, opts.enc_);
+        dw.Finish(fm.GetTotalVars());
+        builtVars = fm.GetTotalVars();
+      } else { // dry run to size the header up front
+        StreamCNF(0);
+        CreateMultiplier counter(soln, opts.enc_);
+        dw.Header(counter.GetTotalVars(), streamedClauses);
+        built = Driver::Seconds();
+        encoderStats = EncoderStats();
+        StreamCNF(&dw);
+        CreateMultiplier fm(soln, opts.enc_);
+        dw.Finish();
+        builtVars = fm.GetTotalVars();
+      }
+      stats = encoderStats; // the clauses were written as built
+      written[0] = builtVars;
+      for ( int p = 0; p < EncoderStats::Parts; ++p ) {
+        written[1] += stats.clauses_[p];
+        written[2] += stats.literals_[p];
+      } // for
+    }
+    if ( toStdout ) {
+      dw.Finish();
+      CloseOutput(out, "");
+    }
+    if ( !opts.stats_.empty() ) {
+      double seconds[3] = { parsed - start, built - parsed, Driver::Seconds() - built };
+      ReportStats(opts.stats_, stats, builtVars, written, seconds);
+    }
     return(EXIT_SUCCESS);
   } catch(bool) {
     /* already output error msg */
@@ -490,5 +3031,3 @@ int main(int argc, char* argv[])
   }
   return(EXIT_FAILURE);
 }
-
-
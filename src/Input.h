@@ -0,0 +1,76 @@
+#ifndef SATFACTOR_INPUT_H
+#define SATFACTOR_INPUT_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+
+/*
+  Input: a WFF or solution file as given, or the output of its decompressor
+   when it begins with the gzip, xz or zstd magic bytes (iencode --compress);
+   the name is never looked at.  '-' is standard input, read as is.  Shared
+   by extract-sat and enumerate-sat.
+*/
+struct Input {
+  explicit Input(const std::string& name) : file_(0), piped_(false) {
+    if ( name == "-" ) {
+      file_ = stdin;
+      return;
+    }
+    file_ = std::fopen(name.c_str(), "rb");
+    if ( !file_ )
+      return;
+    unsigned char magic[6] = { 0, 0, 0, 0, 0, 0 };
+    std::size_t got = std::fread(magic, 1, sizeof(magic), file_);
+    const char* tool = 0;
+    if ( got >= 2 && 0 == std::memcmp(magic, "\x1F\x8B", 2) )
+      tool = "gzip";
+    else if ( got >= 6 && 0 == std::memcmp(magic, "\xFD" "7zXZ\0", 6) )
+      tool = "xz";
+    else if ( got >= 4 && 0 == std::memcmp(magic, "\x28\xB5\x2F\xFD", 4) )
+      tool = "zstd";
+    if ( !tool ) {
+      std::rewind(file_);
+      return;
+    }
+    std::fclose(file_);
+    std::string cmd = std::string(tool) + " -dc < '";
+    for ( std::size_t i = 0; i < name.size(); ++i )
+      cmd += (name[i] == '\'' ? std::string("'\\''") : std::string(1, name[i]));
+    file_ = popen((cmd + "'").c_str(), "r");
+    piped_ = true;
+  }
+
+  // Closing a pipe early stops the decompressor; its status is of no interest
+  ~Input() {
+    if ( !file_ || file_ == stdin )
+      return;
+    else if ( piped_ )
+      pclose(file_);
+    else
+      std::fclose(file_);
+  }
+
+  std::FILE* File() const {
+    return(file_);
+  }
+
+  bool GetLine(std::string& line) {
+    line.clear();
+    int c = EOF;
+    while ( EOF != (c = std::getc(file_)) && c != '\n' )
+      line += static_cast<char>(c);
+    return(c != EOF || !line.empty());
+  }
+
+private:
+  Input(const Input&);
+  Input& operator=(const Input&);
+
+  std::FILE* file_;
+  bool piped_;
+};
+
+#endif // SATFACTOR_INPUT_H
@@ -0,0 +1,171 @@
+#ifndef SATFACTOR_METADATA_H
+#define SATFACTOR_METADATA_H
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/*
+  Metadata: the block of 'c meta' comments iencode writes ahead of the 'p'
+   line, so that readers find each factor bit by its variable rather than
+   by position.  A WFF that has been renumbered (iencode --simplify, or any
+   tool that keeps these comments) still decodes, and so does a model whose
+   literals come in any order.
+
+    c meta widths = 3 5
+    c meta product width = 5
+    c meta variant = --half --simplify
+    c meta N fnv1a = 0x8cf297ec
+    c meta factor A = T 1-2
+    c meta factor B = T 3-6
+
+  Factor bits are listed least significant first: a variable, a run of
+   consecutive variables 'a-b', or T/F for a bit fixed without a variable.
+   The hash is 32-bit FNV-1a of N in decimal, as in the 'c N =' comment.
+  Malformed lines throw a std::string, as the readers report them.
+*/
+struct Metadata {
+  Metadata() : widthA_(0), widthB_(0), productWidth_(0)
+  { /* */ }
+
+  static std::string Hash(const std::string& decimal) {
+    unsigned long h = 2166136261UL;
+    for ( std::size_t i = 0; i < decimal.size(); ++i ) {
+      h ^= static_cast<unsigned char>(decimal[i]);
+      h = (h * 16777619UL) & 0xFFFFFFFFUL;
+    } // for
+    const char* hex = "0123456789abcdef";
+    std::string rtn = "0x";
+    for ( int shift = 28; shift >= 0; shift -= 4 )
+      rtn += hex[(h >> shift) & 0xF];
+    return(rtn);
+  }
+
+  // One factor bit per token, as iencode --simplify maps them: a variable,
+  //  or T/F when forced
+  void Factor(bool first, const std::vector<std::string>& bits) {
+    std::vector<long>& vars = first ? varsA_ : varsB_;
+    std::vector<bool>& fixed = first ? fixedA_ : fixedB_;
+    vars.clear();
+    fixed.clear();
+    for ( std::size_t i = 0; i < bits.size(); ++i ) {
+      long var = 0;
+      if ( bits[i] != "T" && bits[i] != "F" )
+        std::stringstream(bits[i]) >> var;
+      vars.push_back(var);
+      fixed.push_back(bits[i] == "T");
+    } // for
+  }
+
+  // Consecutive variables 'first' on
+  void Factor(bool first, long var, long width) {
+    std::vector<long>& vars = first ? varsA_ : varsB_;
+    std::vector<bool>& fixed = first ? fixedA_ : fixedB_;
+    vars.clear();
+    fixed.assign(width, false);
+    for ( long i = 0; i < width; ++i )
+      vars.push_back(var + i);
+  }
+
+  // The comment lines, without their leading "c "
+  std::vector<std::string> Lines() const {
+    std::vector<std::string> rtn;
+    std::stringstream widths, product;
+    widths << "meta widths = " << widthA_ << " " << widthB_;
+    product << "meta product width = " << productWidth_;
+    rtn.push_back(widths.str());
+    rtn.push_back(product.str());
+    rtn.push_back("meta variant = " + (variant_.empty() ? std::string("default") : variant_));
+    if ( !hash_.empty() )
+      rtn.push_back("meta N fnv1a = " + hash_);
+    rtn.push_back("meta factor A = " + ranges(varsA_, fixedA_));
+    rtn.push_back("meta factor B = " + ranges(varsB_, fixedB_));
+    return(rtn);
+  }
+
+  // Takes in one WFF line; false when it is not part of the block
+  bool Read(const std::string& line) {
+    const std::string tag = "c meta ";
+    if ( line.compare(0, tag.size(), tag) != 0 )
+      return(false);
+    std::string::size_type eq = line.find(" = ");
+    if ( eq == std::string::npos )
+      throw(std::string("Bad metadata line in WFF input file: ") + line);
+    std::string key = line.substr(tag.size(), eq - tag.size()), value = line.substr(eq + 3);
+    std::stringstream in(value);
+    if ( key == "widths" ) {
+      if ( !(in >> widthA_ >> widthB_) )
+        throw(std::string("Bad metadata line in WFF input file: ") + line);
+    } else if ( key == "product width" ) {
+      if ( !(in >> productWidth_) )
+        throw(std::string("Bad metadata line in WFF input file: ") + line);
+    } else if ( key == "variant" ) {
+      variant_ = value;
+    } else if ( key == "N fnv1a" ) {
+      hash_ = value;
+    } else if ( key == "factor A" || key == "factor B" ) {
+      bool first = (key == "factor A");
+      std::vector<long>& vars = first ? varsA_ : varsB_;
+      std::vector<bool>& fixed = first ? fixedA_ : fixedB_;
+      std::string token;
+      while ( in >> token ) {
+        long from = 0, to = 0;
+        char dash = 0;
+        std::stringstream range(token);
+        if ( token == "T" || token == "F" ) {
+          vars.push_back(0);
+          fixed.push_back(token == "T");
+          continue;
+        } else if ( !(range >> from) || from <= 0 ) {
+          throw(std::string("Bad metadata line in WFF input file: ") + line);
+        } else if ( !(range >> dash) ) {
+          to = from;
+        } else if ( dash != '-' || !(range >> to) || to < from ) {
+          throw(std::string("Bad metadata line in WFF input file: ") + line);
+        }
+        for ( long var = from; var <= to; ++var ) {
+          vars.push_back(var);
+          fixed.push_back(false);
+        } // for
+      } // while
+    }
+    return(true);
+  }
+
+  bool Complete() const {
+    return(widthA_ > 0 && widthB_ > 0
+           && varsA_.size() == static_cast<std::size_t>(widthA_)
+           && varsB_.size() == static_cast<std::size_t>(widthB_));
+  }
+
+  long widthA_, widthB_, productWidth_;
+  std::string variant_, hash_;
+  std::vector<long> varsA_, varsB_; // 0 where the bit is fixed
+  std::vector<bool> fixedA_, fixedB_;
+
+private:
+  static std::string ranges(const std::vector<long>& vars, const std::vector<bool>& fixed) {
+    std::stringstream out;
+    for ( std::size_t i = 0; i < vars.size(); ) {
+      if ( i )
+        out << " ";
+      if ( 0 == vars[i] ) {
+        out << (fixed[i] ? "T" : "F");
+        ++i;
+        continue;
+      }
+      std::size_t j = i;
+      while ( j + 1 < vars.size() && vars[j + 1] && vars[j + 1] == vars[j] + 1 )
+        ++j;
+      out << vars[i];
+      if ( j > i )
+        out << "-" << vars[j];
+      i = j + 1;
+    } // for
+    return(out.str());
+  }
+};
+
+#endif // SATFACTOR_METADATA_H
@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Driver.h"
+
+
+/*
+    Runs a small portfolio on one number N:  each encoding variant (a set of
+    iencode options) is written once, and every installed solver is started
+    on every variant at the same time, each pinned to its own CPU where
+    there are enough, taken in turn from those this process may use.  The
+    first solver to answer SAT or UNSAT wins; the others are killed, and a
+    SAT model goes straight to extract-sat.
+
+    A solver is given as a command line.  '{cnf}' is replaced by the CNF
+    file (or the file is appended when absent), and '{out}' by a result
+    file the solver writes itself (MiniSat style); otherwise its standard
+    output is the result.  Answers are taken from the exit code (10 SAT,
+    20 UNSAT) or from the output: 's SATISFIABLE' with 'v' lines, or SAT /
+    UNSAT followed by a line of literals.
+*/
+
+
+namespace { // unnamed
+  const char* DefaultVariants[] = { "", "--half --simplify",
+                                    "--multiplier=dadda --aig --simplify" };
+} // unnamed
+
+enum Result { Unknown, Sat, Unsat };
+
+struct Job {
+  Job(const std::string& solver, std::size_t variant, int cpu)
+    : solver_(solver), variant_(variant), cpu_(cpu), pid_(-1), done_(false)
+  { /* */ }
+
+  std::string solver_;
+  std::size_t variant_;
+  int cpu_;
+  pid_t pid_;
+  bool done_;
+  std::string out_;
+};
+
+struct Options {
+  Options() : timeout_(0), pin_(true), keep_(false), workDir_("/tmp")
+  { /* */ }
+
+  std::string number_, binDir_;
+  std::vector<std::string> solvers_, variants_;
+  long timeout_;
+  bool pin_, keep_;
+  std::string workDir_;
+};
+
+std::string Usage() {
+  std::string rtn = "portfolio [options] --solver <command> ... <binary integer>";
+  rtn += "\nExample: portfolio --solver kissat --solver 'minisat {cnf} {out}' 10001111";
+  rtn += "\n\nOptions:";
+  rtn += "\n  --solver CMD    a solver command line, repeatable.  {cnf} is the CNF";
+  rtn += "\n                  file (appended when absent); {out} is a result file";
+  rtn += "\n                  the solver writes, else its standard output is used";
+  rtn += "\n  --variant OPTS  iencode options of one encoding variant, repeatable;";
+  rtn += "\n                  by default: plain, '--half --simplify' and";
+  rtn += "\n                  '--multiplier=dadda --aig --simplify'";
+  rtn += "\n  --bin DIR       where iencode and extract-sat are (default: next to";
+  rtn += "\n                  portfolio)";
+  rtn += "\n  --timeout S     give up after S seconds";
+  rtn += "\n  --no-pin        do not pin solvers to CPUs";
+  rtn += "\n  --workdir DIR   where CNF and result files go (default /tmp)";
+  rtn += "\n  --keep          leave those files behind";
+  return(rtn);
+}
+
+Options ParseArgs(int argc, char* argv[]) {
+  Options opts;
+  opts.binDir_ = Driver::BinDir(argv[0]);
+  for ( int i = 1; i < argc; ++i ) {
+    std::string arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if ( arg == "--solver" && hasValue )
+      opts.solvers_.push_back(argv[++i]);
+    else if ( arg == "--variant" && hasValue )
+      opts.variants_.push_back(argv[++i]);
+    else if ( arg == "--bin" && hasValue )
+      opts.binDir_ = argv[++i];
+    else if ( arg == "--workdir" && hasValue )
+      opts.workDir_ = argv[++i];
+    else if ( arg == "--timeout" && hasValue )
+      opts.timeout_ = Driver::Number(argv[++i], arg);
+    else if ( arg == "--no-pin" )
+      opts.pin_ = false;
+    else if ( arg == "--keep" )
+      opts.keep_ = true;
+    else if ( arg.empty() || arg[0] == '-' || !opts.number_.empty() )
+      throw(std::string("Unexpected argument: ") + arg);
+    else
+      opts.number_ = arg;
+  } // for
+
+  if ( opts.number_.empty() || opts.solvers_.empty() )
+    throw(std::string("Need at least one --solver and the number to factor"));
+  if ( opts.variants_.empty() )
+    opts.variants_.assign(DefaultVariants, DefaultVariants + 3);
+  return(opts);
+}
+
+// The answer of a finished solver, from its exit code or its output.  A SAT
+//  answer collects the model's literals.
+Result ReadResult(int status, const std::string& outFile,
+                  std::vector<long>& model) {
+  Result result = Unknown;
+  if ( WIFEXITED(status) && 10 == WEXITSTATUS(status) )
+    result = Sat;
+  else if ( WIFEXITED(status) && 20 == WEXITSTATUS(status) )
+    result = Unsat;
+
+  std::ifstream in(outFile.c_str());
+  std::string line;
+  model.clear();
+  while ( std::getline(in, line) ) {
+    std::string::size_type start = line.find_first_not_of(" \t");
+    if ( start == std::string::npos )
+      continue;
+    line = line.substr(start);
+    if ( line == "s SATISFIABLE" || line == "SAT" || line == "SATISFIABLE" )
+      result = Sat;
+    else if ( line == "s UNSATISFIABLE" || line == "UNSAT" || line == "UNSATISFIABLE" )
+      result = Unsat;
+    else if ( line[0] == 'v' || line.find_first_not_of(" -0123456789") == std::string::npos ) {
+      std::stringstream lits(line[0] == 'v' ? line.substr(1) : line);
+      long lit;
+      while ( lits >> lit ) {
+        if ( lit )
+          model.push_back(lit);
+      } // while
+    }
+  } // while
+  if ( result == Sat && model.empty() )
+    result = Unknown; // nothing to extract
+  return(result);
+}
+
+// The CPUs this process may run on (taskset, cgroups), in order
+std::vector<int> AllowedCpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if ( 0 != sched_getaffinity(0, sizeof(set), &set) ) {
+    std::cerr << "Unable to read the allowed CPUs; solvers are not pinned" << std::endl;
+    return(cpus);
+  }
+  for ( int cpu = 0; cpu < CPU_SETSIZE; ++cpu ) {
+    if ( CPU_ISSET(cpu, &set) )
+      cpus.push_back(cpu);
+  } // for
+  return(cpus);
+}
+
+void StopAll(std::vector<Job>& jobs) {
+  for ( std::size_t j = 0; j < jobs.size(); ++j ) {
+    if ( !jobs[j].done_ && jobs[j].pid_ > 0 )
+      killpg(jobs[j].pid_, SIGTERM);
+  } // for
+  usleep(200000);
+  for ( std::size_t j = 0; j < jobs.size(); ++j ) {
+    if ( jobs[j].done_ || jobs[j].pid_ <= 0 )
+      continue;
+    killpg(jobs[j].pid_, SIGKILL);
+    waitpid(jobs[j].pid_, 0, 0);
+    jobs[j].done_ = true;
+  } // for
+}
+
+
+//========
+// main()
+//========
+int main(int argc, char* argv[]) {
+  std::vector<std::string> files;
+  bool keep = true;
+  int rtn = EXIT_FAILURE;
+  std::vector<Job> jobs;
+  try {
+    if ( argc == 2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help") ) {
+      std::cout << Usage() << std::endl;
+      return(EXIT_SUCCESS);
+    }
+    Options opts = ParseArgs(argc, argv);
+    keep = opts.keep_;
+    Driver::CatchAlarm();
+    Driver::Alarm(opts.timeout_);
+
+    // One CNF per encoding variant
+    std::stringstream base;
+    base << opts.workDir_ << "/portfolio-" << getpid();
+    std::vector<std::string> cnfs;
+    for ( std::size_t v = 0; v < opts.variants_.size(); ++v ) {
+      std::stringstream name;
+      name << base.str() << "-v" << v << ".cnf";
+      cnfs.push_back(name.str());
+      files.push_back(name.str());
+      std::vector<std::string> args = Driver::SplitWords(opts.variants_[v]);
+      args.push_back(opts.number_);
+      int status = Driver::Run(opts.binDir_ + "/iencode", args, cnfs.back());
+      if ( Driver::TimedOut() )
+        throw(std::string("Timed out"));
+      else if ( !Driver::Exited(status, 0) )
+        throw(std::string("iencode failed on variant '") + opts.variants_[v] + "'");
+    } // for
+
+    // Every solver on every variant
+    std::vector<int> cpus;
+    if ( opts.pin_ )
+      cpus = AllowedCpus();
+    for ( std::size_t s = 0; s < opts.solvers_.size(); ++s ) {
+      for ( std::size_t v = 0; v < cnfs.size(); ++v ) {
+        int cpu = cpus.empty() ? -1 : cpus[jobs.size() % cpus.size()];
+        jobs.push_back(Job(opts.solvers_[s], v, cpu));
+      } // for
+    } // for
+    for ( std::size_t j = 0; j < jobs.size(); ++j ) {
+      std::stringstream name;
+      name << base.str() << "-j" << j << ".out";
+      std::string command = jobs[j].solver_, stdoutFile = name.str() + ".log";
+      jobs[j].out_ = name.str();
+      if ( command.find("{cnf}") == std::string::npos )
+        command += " {cnf}";
+      if ( command.find("{out}") == std::string::npos )
+        jobs[j].out_ = stdoutFile;
+      Driver::Replace(command, "{cnf}", "'" + cnfs[jobs[j].variant_] + "'");
+      Driver::Replace(command, "{out}", "'" + jobs[j].out_ + "'");
+      files.push_back(name.str());
+      files.push_back(stdoutFile);
+      jobs[j].pid_ = Driver::Launch(command, stdoutFile, jobs[j].cpu_);
+    } // for
+
+    // First decisive answer wins
+    std::size_t running = jobs.size();
+    std::vector<long> model;
+    Result result = Unknown;
+    Job* winner = 0;
+    while ( running && !winner ) {
+      int status = 0;
+      pid_t pid = waitpid(-1, &status, 0);
+      if ( pid < 0 ) {
+        if ( Driver::TimedOut() )
+          break;
+        continue;
+      }
+      for ( std::size_t j = 0; j < jobs.size(); ++j ) {
+        if ( jobs[j].pid_ != pid || jobs[j].done_ )
+          continue;
+        jobs[j].done_ = true;
+        --running;
+        result = ReadResult(status, jobs[j].out_, model);
+        if ( result != Unknown )
+          winner = &jobs[j];
+      } // for
+    } // while
+    StopAll(jobs);
+
+    if ( !winner ) {
+      std::cerr << (Driver::TimedOut() ? "Timed out" : "No solver gave an answer") << std::endl;
+    } else {
+      const std::string& variant = opts.variants_[winner->variant_];
+      std::cout << "Solved by: " << winner->solver_ << " on iencode "
+                << (variant.empty() ? "(default)" : variant) << std::endl;
+      if ( result == Unsat )
+        std::cout << "No Solution Found: Number is PRIME" << std::endl;
+      else {
+        std::string solution = base.str() + ".solution";
+        files.push_back(solution);
+        std::ofstream out(solution.c_str());
+        out << "solution =";
+        for ( std::size_t i = 0; i < model.size(); ++i )
+          out << " " << model[i];
+        out << std::endl;
+        out.close();
+        std::vector<std::string> args;
+        args.push_back(cnfs[winner->variant_]);
+        args.push_back(solution);
+        if ( !Driver::Exited(Driver::Run(opts.binDir_ + "/extract-sat", args, ""), 0) )
+          throw(std::string("extract-sat failed"));
+      }
+      rtn = EXIT_SUCCESS;
+    }
+  } catch(std::string& s) {
+    StopAll(jobs);
+    std::cerr << s << std::endl;
+    std::cerr << "use portfolio -h for help" << std::endl;
+  } catch(std::exception& e) {
+    StopAll(jobs);
+    std::cerr << e.what() << std::endl;
+  } catch(...) {
+    StopAll(jobs);
+    std::cerr << "Unknown runtime error" << std::endl;
+  }
+
+  if ( !keep ) {
+    for ( std::size_t i = 0; i < files.size(); ++i )
+      std::remove(files[i].c_str());
+  }
+  return(rtn);
+}